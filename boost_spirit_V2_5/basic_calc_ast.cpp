@@ -8,6 +8,9 @@
 #include <boost/fusion/include/adapt_struct.hpp>
 #include <boost/foreach.hpp>
 
+#include "qi_skipper.hpp"
+#include "qi_swar_int.hpp"
+
 #include <iostream>
 #include <string>
 #include <list>
@@ -130,10 +133,9 @@ struct calc_program_eval{
 
 //the grammar - parsing using semantic actions...
 
-template<typename Iterator>
-struct calc_grammar : qi::grammar<Iterator, calc_program(), ascii::space_type>{
+template<typename Iterator, typename Skipper = fast_space_type>
+struct calc_grammar : qi::grammar<Iterator, calc_program(), Skipper>{
   calc_grammar() : calc_grammar::base_type(expression){
-    qi::uint_type uint_; //parser
     qi::char_type char_;
 
     qi::_val_type _val; //the enclosing rule's synthesized attribute
@@ -143,12 +145,12 @@ struct calc_grammar : qi::grammar<Iterator, calc_program(), ascii::space_type>{
 
     term = factor >> *( (char_('*') >> factor) | (char_('/') >> factor) );
 
-    factor = uint_ | '(' >> expression >> ')' | (char_('-') >> factor) | (char_('+') >> factor);
+    factor = swar_uint_ | '(' >> expression >> ')' | (char_('-') >> factor) | (char_('+') >> factor);
   }
 
-  qi::rule<Iterator, calc_program(), ascii::space_type> expression;
-  qi::rule<Iterator, calc_program(), ascii::space_type> term;
-  qi::rule<Iterator, calc_operand(), ascii::space_type> factor;
+  qi::rule<Iterator, calc_program(), Skipper> expression;
+  qi::rule<Iterator, calc_program(), Skipper> term;
+  qi::rule<Iterator, calc_operand(), Skipper> factor;
 };
 
 //g++ file.cpp -std=c++11
@@ -162,7 +164,7 @@ int main( /* ... */ ){
     auto iter = line.begin();
     auto end = line.end();
 
-    ascii::space_type ws;
+    fast_space_type ws;
     calc_grammar<std::string::iterator> gram;
     calc_program prog;
     calc_program_eval eval;
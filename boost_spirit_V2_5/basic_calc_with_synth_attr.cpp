@@ -3,6 +3,9 @@
 #include <boost/spirit/include/qi.hpp>
 #include <boost/spirit/include/phoenix_operator.hpp>
 
+#include "qi_skipper.hpp"
+#include "qi_swar_int.hpp"
+
 #include <iostream>
 #include <string>
 
@@ -50,10 +53,9 @@ Sequential Or                   a || b      shortcut for: a >> -b | b  , e.g. in
 */
 
 //parsing using synthesized attributes...
-template<typename Iterator>
-struct calc_grammar : qi::grammar<Iterator, int(), ascii::space_type>{
+template<typename Iterator, typename Skipper = fast_space_type>
+struct calc_grammar : qi::grammar<Iterator, int(), Skipper>{
   calc_grammar() : calc_grammar::base_type(expression){
-    qi::uint_type uint_; //parser
 
     qi::_val_type _val; //the enclosing rule's synthesized attribute
     qi::_1_type _1;     //first attribute of the parser
@@ -62,10 +64,10 @@ struct calc_grammar : qi::grammar<Iterator, int(), ascii::space_type>{
 
     term = factor [_val = _1] >> *( ('*' >> factor [_val *= _1]) | ('/' >> factor [_val /= _1]) );
 
-    factor = uint_ [_val = _1] | '(' >> expression [_val = _1] >> ')' | ('-' >> factor [_val = -_1]) | ('+' >> factor [_val = +_1]);
+    factor = swar_uint_ [_val = _1] | '(' >> expression [_val = _1] >> ')' | ('-' >> factor [_val = -_1]) | ('+' >> factor [_val = +_1]);
   }
 
-  qi::rule<Iterator, int(), ascii::space_type> expression, term, factor;
+  qi::rule<Iterator, int(), Skipper> expression, term, factor;
 };
 
 //g++ file.cpp -std=c++11
@@ -79,7 +81,7 @@ int main( /* ... */ ){
     auto iter = line.begin();
     auto end = line.end();
 
-    ascii::space_type ws;
+    fast_space_type ws;
     calc_grammar<std::string::iterator> gram;
 
     int res;
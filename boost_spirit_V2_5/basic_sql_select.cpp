@@ -6,7 +6,12 @@
 #include <boost/fusion/adapted.hpp>
 #include <boost/optional.hpp>
 
+#include "qi_script.hpp"
+#include "qi_skipper.hpp"
+
+#include <fstream>
 #include <iostream>
+#include <iterator>
 #include <string>
 #include <vector>
 
@@ -59,8 +64,8 @@ std::ostream& operator<<(std::ostream& os, basic_select const& se){
 }
 
 //parsing using synthesized attributes...
-template<typename Iterator>
-struct basic_select_grammar : qi::grammar<Iterator, basic_select(), ascii::space_type>{
+template<typename Iterator, typename Skipper = sql_space_type>
+struct basic_select_grammar : qi::grammar<Iterator, basic_select(), Skipper>{
   basic_select_grammar() : basic_select_grammar::base_type(expression){
     using namespace qi;
 
@@ -79,21 +84,45 @@ struct basic_select_grammar : qi::grammar<Iterator, basic_select(), ascii::space
     expression  = columns >> table >> (where | ';');
   }
 
-  qi::rule<Iterator, basic_select(), ascii::space_type> expression;
-  qi::rule<Iterator, std::vector<std::string>(), ascii::space_type> columns;
-  qi::rule<Iterator, std::string(), ascii::space_type> table;
-  qi::rule<Iterator, std::string(), ascii::space_type> where;
-  qi::rule<Iterator, std::string(), ascii::space_type> ident;
+  qi::rule<Iterator, basic_select(), Skipper> expression;
+  qi::rule<Iterator, std::vector<std::string>(), Skipper> columns;
+  qi::rule<Iterator, std::string(), Skipper> table;
+  qi::rule<Iterator, std::string(), Skipper> where;
+  qi::rule<Iterator, std::string(), Skipper> ident;
 };
 
 /*
 The WHERE part of the query is optional.
 */
 
+//the statements of a script file in one pass, bad ones reported and skipped up to their ';'
+int run_script(std::string const& file){
+  std::ifstream in(file.c_str(), std::ios::binary);
+  if( !in ){
+    std::cout << "can not open " << file << "\n";
+    return 1;
+  }
+  std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+  typedef std::string::const_iterator iterator;
+  basic_select_grammar<iterator> gram;
+  script_grammar<iterator, basic_select, sql_space_type> script(gram,
+    [](basic_select& se){ std::cout << "Parsing succeeded - result: " << se << "\n"; },
+    [](script_error const& e){ std::cout << "Parsing failed - line " << e.line_ << ": \" " << e.text_ << "\"\n"; });
+
+  auto first = text.cbegin();
+  qi::phrase_parse(first, text.cend(), script, sql_space);
+  std::cout << script.statements_ << " statements, " << script.errors_ << " errors\n";
+  return script.errors_ ? 1 : 0;
+}
+
 //g++ file.cpp -std=c++11
+//./a.out                  a statement per line, up to an empty line
+//./a.out --script file    the statements of file
 
-int main( /* ... */ ){
+int main(int argc, char* argv[]){
   std::cout << "\n";
+  if( argc > 2 && std::string(argv[1]) == "--script" ) return run_script(argv[2]);
 
   std::string line;
   while (std::getline(std::cin, line)){
@@ -102,7 +131,7 @@ int main( /* ... */ ){
     auto iter = line.begin();
     auto end = line.end();
 
-    ascii::space_type ws;
+    sql_space_type ws;
     basic_select_grammar<std::string::iterator> gram;
 
     basic_select se;
@@ -7,11 +7,51 @@
 #include <boost/spirit/include/phoenix.hpp>
 #include <boost/optional.hpp>
 #include <boost/variant.hpp>
+#include <boost/algorithm/string/case_conv.hpp>
 
+#include "qi_script.hpp"
+#include "qi_skipper.hpp"
+#include "qi_swar_int.hpp"
+#include "sql_cancel.hpp"
+#include "sql_table.hpp"
+#include "sql_parallel.hpp"
+#include "sql_predicate.hpp"
+#include "sql_sort.hpp"
+#include "sql_hash_agg.hpp"
+#include "sql_hll.hpp"
+#include "sql_colfile.hpp"
+#include "sql_csv.hpp"
+#include "sql_hash_join.hpp"
+#include "sql_matview.hpp"
+#include "sql_result_cache.hpp"
+#include "sql_sample.hpp"
+#include "sql_scheduler.hpp"
+#include "sql_shared_scan.hpp"
+#include "sql_store.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+#include <dirent.h>
+
 namespace qi = boost::spirit::qi;
 namespace ascii = boost::spirit::ascii;
 
@@ -36,18 +76,42 @@ Permutation                     a ^ b       parse a,b in any order, each element
 Sequential Or                   a || b      shortcut for: a >> -b | b  , e.g. int_ || ('.' >> int_)  matches any of "123.12", ".456", "123"
 */
 
-//the statement : SELECT columns FROM table WHERE conditions
+//the statement : SELECT columns FROM table TABLESAMPLE (amount PERCENT|ROWS) REPEATABLE (seed) JOIN table ON field == field WHERE conditions GROUP BY fields ORDER BY orders LIMIT count OFFSET offset
+//column names may be qualified by their table: table.column
+
+//columns: plain identifiers or aggregates, like COUNT(*), SUM(score) or APPROX_COUNT_DISTINCT(name)
+enum basic_aggregate_fn { agg_count, agg_sum, agg_min, agg_max, agg_approx_count_distinct };
+
+struct basic_aggregate{
+  basic_aggregate_fn fn_;
+  std::string field_; //"*" for COUNT(*)
+};
 
-//columns
-using basic_column = std::string;
+using basic_column = boost::variant<std::string, basic_aggregate>;
 using basic_columns = std::vector<basic_column>;
 
 //table
 using basic_table = std::string;
 
+//tablesample
+enum basic_sample_unit { unit_percent, unit_rows };
+
+struct basic_sample{
+  double amount_;
+  basic_sample_unit unit_;
+  unsigned seed_;
+};
+
+//join
+struct basic_join{
+  basic_table table_;
+  std::string left_;
+  std::string right_;
+};
+
 //condition(s)
 using basic_field = std::string;
-enum basic_op { op_eq, op_neq };
+enum basic_op { op_eq, op_neq, op_lt, op_le, op_gt, op_ge, op_between };
 
 struct null{};
 using basic_value = boost::variant<null, int, std::string>;
@@ -56,32 +120,156 @@ struct basic_condition{
   basic_field   field_;
   basic_op      op_;
   basic_value   value_;
+  basic_value   high_;    //BETWEEN value_ AND high_, null for the other operators
 };
 
 using basic_conditions = std::vector<basic_condition>;
 
+//group by
+using basic_group_by = std::vector<basic_field>;
+
+//order by
+enum basic_direction { dir_asc, dir_desc };
+
+struct basic_order{
+  basic_column  column_;
+  basic_direction direction_;
+};
+
+using basic_orders = std::vector<basic_order>;
+
+//limit
+struct basic_limit{
+  unsigned count_;
+  unsigned offset_;
+};
+
 //
 
 struct basic_select{
   basic_columns columns_;
   basic_table table_;
+  boost::optional<basic_sample> sample_;
+  boost::optional<basic_join> join_;
   boost::optional<basic_conditions> conditions_;
+  boost::optional<basic_group_by> group_by_;
+  boost::optional<basic_orders> orders_;
+  boost::optional<basic_limit> limit_;
+};
+
+//the statements: a select, CREATE MATERIALIZED VIEW name AS select,
+//INSERT INTO table (columns) VALUES (values), (values) or UPDATE table SET field = value, field = value WHERE conditions
+struct basic_create_view{
+  std::string name_;
+  basic_select select_;
 };
 
+using basic_values = std::vector<basic_value>;
+
+struct basic_insert{
+  basic_table table_;
+  std::vector<basic_field> columns_;
+  std::vector<basic_values> rows_;
+};
+
+struct basic_assignment{
+  basic_field field_;
+  basic_value value_;
+};
+
+using basic_assignments = std::vector<basic_assignment>;
+
+struct basic_update{
+  basic_table table_;
+  basic_assignments assignments_;
+  boost::optional<basic_conditions> conditions_;
+};
+
+using basic_statement = boost::variant<basic_select, basic_create_view, basic_insert, basic_update>;
+
+BOOST_FUSION_ADAPT_STRUCT(
+  basic_aggregate,
+  (basic_aggregate_fn, fn_)
+  (std::string, field_)
+)
+
+BOOST_FUSION_ADAPT_STRUCT(
+  basic_sample,
+  (double, amount_)
+  (basic_sample_unit, unit_)
+  (unsigned, seed_)
+)
+
+BOOST_FUSION_ADAPT_STRUCT(
+  basic_join,
+  (basic_table, table_)
+  (std::string, left_)
+  (std::string, right_)
+)
+
 BOOST_FUSION_ADAPT_STRUCT(
   basic_condition,
   (basic_field, field_)
   (basic_op, op_)
   (basic_value, value_)
+  (basic_value, high_)
+)
+
+BOOST_FUSION_ADAPT_STRUCT(
+  basic_order,
+  (basic_column, column_)
+  (basic_direction, direction_)
+)
+
+BOOST_FUSION_ADAPT_STRUCT(
+  basic_limit,
+  (unsigned, count_)
+  (unsigned, offset_)
 )
 
 BOOST_FUSION_ADAPT_STRUCT(
   basic_select,
   (basic_columns, columns_)
   (basic_table, table_)
+  (boost::optional<basic_sample>, sample_)
+  (boost::optional<basic_join>, join_)
+  (boost::optional<basic_conditions>, conditions_)
+  (boost::optional<basic_group_by>, group_by_)
+  (boost::optional<basic_orders>, orders_)
+  (boost::optional<basic_limit>, limit_)
+)
+
+BOOST_FUSION_ADAPT_STRUCT(
+  basic_create_view,
+  (std::string, name_)
+  (basic_select, select_)
+)
+
+BOOST_FUSION_ADAPT_STRUCT(
+  basic_insert,
+  (basic_table, table_)
+  (std::vector<basic_field>, columns_)
+  (std::vector<basic_values>, rows_)
+)
+
+BOOST_FUSION_ADAPT_STRUCT(
+  basic_assignment,
+  (basic_field, field_)
+  (basic_value, value_)
+)
+
+BOOST_FUSION_ADAPT_STRUCT(
+  basic_update,
+  (basic_table, table_)
+  (basic_assignments, assignments_)
   (boost::optional<basic_conditions>, conditions_)
 )
 
+std::ostream& operator<<(std::ostream& os, basic_aggregate const& agg){
+  static const char* names[] = { "count", "sum", "min", "max", "approx_count_distinct" };
+  return os << names[agg.fn_] << "(" << agg.field_ << ")";
+}
+
 std::ostream& operator<<(std::ostream& os, basic_columns const& columns){
   for(auto& col : columns){ os << col << " "; }
   return os;
@@ -95,6 +283,11 @@ std::ostream& operator<<(std::ostream& os, basic_op const& o){
   switch( o ){
     case op_eq: return os << "==";
     case op_neq: return os << "!=";
+    case op_lt: return os << "<";
+    case op_le: return os << "<=";
+    case op_gt: return os << ">";
+    case op_ge: return os << ">=";
+    case op_between: return os << "between";
   }
   return os << "?";
 }
@@ -103,8 +296,21 @@ std::ostream& operator<<(std::ostream& os, basic_conditions const& conditions){
   for(auto& cond : conditions){
     os  << "[ Fld{" << cond.field_ 
         << "} Op{" << cond.op_ 
-        << "} Value{" << cond.value_
-        << "} ]";
+        << "} Value{" << cond.value_;
+    if( cond.op_ == op_between ) os << "} And{" << cond.high_;
+    os  << "} ]";
+  }
+  return os;
+}
+
+std::ostream& operator<<(std::ostream& os, basic_group_by const& fields){
+  for(auto& field : fields){ os << field << " "; }
+  return os;
+}
+
+std::ostream& operator<<(std::ostream& os, basic_orders const& orders){
+  for(auto& order : orders){
+    os << order.column_ << (order.direction_ == dir_asc ? " ASC " : " DESC ");
   }
   return os;
 }
@@ -112,66 +318,1839 @@ std::ostream& operator<<(std::ostream& os, basic_conditions const& conditions){
 std::ostream& operator<<(std::ostream& os, basic_select const& select){
   os  << "\nSELECT: " << select.columns_
       << "\nFROM: " << select.table_;
+  if( select.sample_ )
+    os  << "\nTABLESAMPLE: " << select.sample_->amount_ << (select.sample_->unit_ == unit_percent ? " PERCENT" : " ROWS")
+        << " REPEATABLE: " << select.sample_->seed_;
+  if( select.join_ )
+    os  << "\nJOIN: " << select.join_->table_ << " ON " << select.join_->left_ << " == " << select.join_->right_;
   if( select.conditions_ )
     os  << "\nWHERE: " << *select.conditions_;
+  if( select.group_by_ )
+    os  << "\nGROUP BY: " << *select.group_by_;
+  if( select.orders_ )
+    os  << "\nORDER BY: " << *select.orders_;
+  if( select.limit_ )
+    os  << "\nLIMIT: " << select.limit_->count_ << " OFFSET: " << select.limit_->offset_;
+  return os << "\n";
+}
+
+std::ostream& operator<<(std::ostream& os, basic_create_view const& view){
+  return os << "\nCREATE MATERIALIZED VIEW: " << view.name_ << " AS" << view.select_;
+}
+
+std::ostream& operator<<(std::ostream& os, basic_insert const& insert){
+  os << "\nINSERT INTO: " << insert.table_ << " (";
+  for(auto& column : insert.columns_){ os << " " << column; }
+  os << " )\nVALUES: " << insert.rows_.size() << " rows";
+  if( !insert.rows_.empty() ){
+    os << ", the first (";
+    for(auto& v : insert.rows_.front()){ os << " " << v; }
+    os << " )";
+  }
+  return os << "\n";
+}
+
+std::ostream& operator<<(std::ostream& os, basic_update const& update){
+  os << "\nUPDATE: " << update.table_ << "\nSET:";
+  for(auto& a : update.assignments_){ os << " " << a.field_ << " = " << a.value_; }
+  if( update.conditions_ ) os << "\nWHERE: " << *update.conditions_;
   return os << "\n";
 }
 
 //parsing using synthesized attributes...
-template<typename Iterator>
-struct basic_select_grammar : qi::grammar<Iterator, basic_select(), ascii::space_type>{
+template<typename Iterator, typename Skipper = sql_space_type>
+struct basic_select_grammar : qi::grammar<Iterator, basic_select(), Skipper>{
   basic_select_grammar() : basic_select_grammar::base_type(expression_){
     using namespace qi;
  
     /* Note: you can use lexeme or remove the skipper from the rule in order to inhibit skipping WS */
 
-    ident_ = lexeme [ alpha >> *alnum ];   //columns, table
+    ident_ = lexeme [ alpha >> *alnum ];   //table
+    name_ = lexeme [ raw [ alpha >> *alnum >> -('.' >> alpha >> *alnum) ] ];  //columns, like: column or table.column
     strlit_ = lexeme ["'" >> *~char_("'") >> "'"];  //string literal, like: 'string'
     nulllit_ = no_case["null" >> attr(null())]; //
 
-    field_ = ident_;
+    field_ = name_;
     op_token.add
       ("==", op_eq)
-      ("!=", op_neq);
+      ("!=", op_neq)
+      ("<", op_lt)
+      ("<=", op_le)
+      (">", op_gt)
+      (">=", op_ge);
     op_ = no_case[op_token];
-    value_ = int_ | strlit_ | nulllit_;
+    value_ = swar_int_ | strlit_ | nulllit_;
+
+    //hold: a field parsed by the first alternative must not stay in the attribute when it fails
+    condition_ = hold[field_ >> no_case["between"] >> attr(op_between) >> value_ >> no_case["and"] >> value_]
+               | (field_ >> op_ >> value_ >> attr(null()));
 
-    condition_ = (field_ >> op_ >> value_);
+    aggregate_token.add
+      ("count", agg_count)
+      ("sum", agg_sum)
+      ("min", agg_min)
+      ("max", agg_max)
+      ("approx_count_distinct", agg_approx_count_distinct);
+    aggregate_ = (no_case[aggregate_token] >> '(' >> (name_ | string("*")) >> ')');
+    column_ = aggregate_ | name_;
 
-    columns_ = (no_case["select"] >> (ident_ % ','));
+    columns_ = (no_case["select"] >> (column_ % ','));
     table_ = (no_case["from"] >> ident_);
+    sample_unit_token.add
+      ("percent", unit_percent)
+      ("rows", unit_rows);
+    sample_ = (no_case["tablesample"] >> '(' >> double_ >> no_case[sample_unit_token] >> ')'
+              >> (no_case["repeatable"] >> '(' >> swar_uint_ >> ')' | attr(0u)));
+    join_ = (no_case["join"] >> ident_ >> no_case["on"] >> name_ >> "==" >> name_);
     conditions_ = (no_case["where"] >> (condition_ % no_case["and"]));
+    direction_token.add
+      ("asc", dir_asc)
+      ("desc", dir_desc);
+    group_by_ = (no_case["group"] >> no_case["by"] >> (field_ % ','));
+    order_ = (column_ >> (no_case[direction_token] | attr(dir_asc)));
+    orders_ = (no_case["order"] >> no_case["by"] >> (order_ % ','));
+    limit_ = (no_case["limit"] >> swar_uint_ >> (no_case["offset"] >> swar_uint_ | attr(0u)));
 
-    expression_  = columns_ >> table_ >> -conditions_ >> ';';
+    expression_  = columns_ >> table_ >> -sample_ >> -join_ >> -conditions_ >> -group_by_ >> -orders_ >> -limit_ >> ';';
   }
   
   //aux
-  qi::rule<Iterator, std::string(),     ascii::space_type> ident_;
-  qi::rule<Iterator, std::string(),     ascii::space_type> strlit_;
-  qi::rule<Iterator, null(),            ascii::space_type> nulllit_;
+  qi::rule<Iterator, std::string(),     Skipper> ident_;
+  qi::rule<Iterator, std::string(),     Skipper> name_;
+  qi::rule<Iterator, std::string(),     Skipper> strlit_;
+  qi::rule<Iterator, null(),            Skipper> nulllit_;
  
   //condition
-  qi::rule<Iterator, basic_field(),     ascii::space_type> field_;
+  qi::rule<Iterator, basic_field(),     Skipper> field_;
   qi::symbols<char, basic_op> op_token;
-  qi::rule<Iterator, basic_op(),        ascii::space_type> op_;
-  qi::rule<Iterator, basic_value(),     ascii::space_type> value_;
+  qi::rule<Iterator, basic_op(),        Skipper> op_;
+  qi::rule<Iterator, basic_value(),     Skipper> value_;
 
-  qi::rule<Iterator, basic_condition(), ascii::space_type> condition_;
+  qi::rule<Iterator, basic_condition(), Skipper> condition_;
   
+  //columns
+  qi::symbols<char, basic_aggregate_fn> aggregate_token;
+  qi::rule<Iterator, basic_aggregate(), Skipper> aggregate_;
+  qi::rule<Iterator, basic_column(),    Skipper> column_;
+
   //parts
-  qi::rule<Iterator, basic_columns(),   ascii::space_type> columns_;
-  qi::rule<Iterator, basic_table(),     ascii::space_type> table_;
-  qi::rule<Iterator, basic_conditions(),ascii::space_type> conditions_;
+  qi::rule<Iterator, basic_columns(),   Skipper> columns_;
+  qi::rule<Iterator, basic_table(),     Skipper> table_;
+  qi::symbols<char, basic_sample_unit> sample_unit_token;
+  qi::rule<Iterator, basic_sample(),    Skipper> sample_;
+  qi::rule<Iterator, basic_join(),      Skipper> join_;
+  qi::rule<Iterator, basic_conditions(),Skipper> conditions_;
+  qi::rule<Iterator, basic_group_by(),  Skipper> group_by_;
+  qi::symbols<char, basic_direction> direction_token;
+  qi::rule<Iterator, basic_order(),     Skipper> order_;
+  qi::rule<Iterator, basic_orders(),    Skipper> orders_;
+  qi::rule<Iterator, basic_limit(),     Skipper> limit_;
   
   //basic select
-  qi::rule<Iterator, basic_select(),    ascii::space_type> expression_;
+  qi::rule<Iterator, basic_select(),    Skipper> expression_;
+};
+
+//any statement: a select, a view definition or a write
+template<typename Iterator, typename Skipper = sql_space_type>
+struct basic_statement_grammar : qi::grammar<Iterator, basic_statement(), Skipper>{
+  basic_statement_grammar() : basic_statement_grammar::base_type(statement_){
+    using namespace qi;
+
+    create_view_ = (no_case["create"] >> no_case["materialized"] >> no_case["view"] >> select_.ident_ >> no_case["as"] >> select_);
+
+    values_ = ('(' >> (select_.value_ % ',') >> ')');
+    insert_ = (no_case["insert"] >> no_case["into"] >> select_.ident_ >> '(' >> (select_.field_ % ',') >> ')'
+              >> no_case["values"] >> (values_ % ',') >> ';');
+
+    assignment_ = (select_.field_ >> '=' >> select_.value_);
+    update_ = (no_case["update"] >> select_.ident_ >> no_case["set"] >> (assignment_ % ',') >> -select_.conditions_ >> ';');
+
+    statement_ = create_view_ | insert_ | update_ | select_;
+  }
+
+  basic_select_grammar<Iterator, Skipper> select_;
+  qi::rule<Iterator, basic_create_view(), Skipper> create_view_;
+  qi::rule<Iterator, basic_values(),      Skipper> values_;
+  qi::rule<Iterator, basic_insert(),      Skipper> insert_;
+  qi::rule<Iterator, basic_assignment(),  Skipper> assignment_;
+  qi::rule<Iterator, basic_update(),      Skipper> update_;
+  qi::rule<Iterator, basic_statement(),   Skipper> statement_;
+};
+
+//execution over in-memory tables (see sql_table.hpp)
+
+//the tables a statement reads: a snapshot of the catalog (see sql_store.hpp), keyed by lower case table name
+using database = std::map<std::string, std::shared_ptr<table_data const>>;
+
+table_data const& find_table(database const& db, basic_table const& name){
+  auto it = db.find(boost::to_lower_copy(name));
+  if( it == db.end() ) throw std::runtime_error("unknown table: " + name);
+  return *it->second;
+}
+
+//the values of a result: ints are widened so that sums do not overflow
+using result_value = boost::variant<null, long long, std::string>;
+
+struct result_set{
+  std::vector<std::string> names_;
+  std::vector<std::vector<result_value>> rows_;
+};
+
+std::ostream& operator<<(std::ostream& os, result_set const& rs){
+  const std::size_t max_printed_rows = 20;
+
+  for(auto& name : rs.names_){ os << name << "\t"; }
+  os << "\n";
+  for(std::size_t r = 0; r < rs.rows_.size() && r < max_printed_rows; ++r){
+    for(auto& v : rs.rows_[r]){ os << v << "\t"; }
+    os << "\n";
+  }
+  if( rs.rows_.size() > max_printed_rows ) os << "...\n";
+  return os << "(" << rs.rows_.size() << " rows)\n";
+}
+
+std::string column_label(basic_column const& column){
+  std::ostringstream os;
+  os << column;
+  return os.str();
+}
+
+bool is_aggregate(basic_column const& column){
+  return boost::get<basic_aggregate>(&column) != nullptr;
+}
+
+//the name of a plain column
+std::string const& plain_column(basic_column const& column){
+  if( auto name = boost::get<std::string>(&column) ) return *name;
+  throw std::runtime_error("aggregate not allowed here: " + column_label(column));
+}
+
+//a condition with its field resolved to a column index
+struct bound_condition{
+  int column_;
+  basic_op op_;
+  basic_value value_;
+  basic_value high_;
+
+  //int columns: every operator but != holds for lo_ <= value <= hi_ (nothing when lo_ > hi_),
+  //!= for the values outside [lo_, hi_]
+  int lo_ = 1;
+  int hi_ = 0;
+};
+
+/*
+The conditions of a statement over one table. The comparisons of int columns with a literal run
+on the columns a batch at a time (select_batch), the others (string columns, null tests) are
+compiled into rest_, see sql_predicate.hpp.
+*/
+struct bound_conditions{
+  std::vector<bound_condition> conds_;
+  row_filter_ptr rest_;   //null when every condition is an int comparison
+};
+
+//the closed interval of the values of an int column passing a comparison with v (high for BETWEEN)
+bool int_interval(basic_op op, int v, int high, int& lo, int& hi){
+  const int min = std::numeric_limits<int>::min(), max = std::numeric_limits<int>::max();
+  switch( op ){
+    case op_lt: if( v == min ) return false; lo = min; hi = v - 1; break;
+    case op_le: lo = min; hi = v; break;
+    case op_gt: if( v == max ) return false; lo = v + 1; hi = max; break;
+    case op_ge: lo = v; hi = max; break;
+    case op_between: lo = v; hi = high; break;
+    default: lo = hi = v; break;
+  }
+  return lo <= hi;
+}
+
+bool is_int_value(basic_value const& v){ return boost::get<int>(&v) != nullptr; }
+
+compare_op compare_of(basic_op op){
+  switch( op ){
+    case op_eq: return cmp_eq;
+    case op_neq: return cmp_neq;
+    case op_lt: return cmp_lt;
+    case op_le: return cmp_le;
+    case op_gt: return cmp_gt;
+    case op_ge: return cmp_ge;
+    default: return cmp_between;
+  }
+}
+
+bound_conditions bind_conditions(table_schema const& schema, boost::optional<basic_conditions> const& conditions){
+  bound_conditions bound;
+  if( !conditions ) return bound;
+  std::vector<row_filter_ptr> rest;
+  for(auto& cond : *conditions){
+    int c = schema.at(cond.field_);
+    bool is_null = boost::get<null>(&cond.value_) != nullptr;
+    if( is_null && cond.op_ != op_eq && cond.op_ != op_neq )
+      throw std::runtime_error("only == and != compare with null, in condition on column: " + cond.field_);
+    if( !is_null && is_int_value(cond.value_) != (schema.kinds_[c] == col_int) )
+      throw std::runtime_error("type mismatch in condition on column: " + cond.field_);
+    if( cond.op_ == op_between && (boost::get<null>(&cond.high_) || is_int_value(cond.high_) != (schema.kinds_[c] == col_int)) )
+      throw std::runtime_error("type mismatch in condition on column: " + cond.field_);
+
+    bound_condition b;
+    b.column_ = c;
+    b.op_ = cond.op_;
+    b.value_ = cond.value_;
+    b.high_ = cond.high_;
+    if( !is_null && schema.kinds_[c] == col_int ){
+      int high = cond.op_ == op_between ? boost::get<int>(cond.high_) : 0;
+      if( !int_interval(cond.op_, boost::get<int>(cond.value_), high, b.lo_, b.hi_) ){
+        b.lo_ = 1;
+        b.hi_ = 0;
+      }
+    }
+    //"== null" / "!= null" test for null, a null never passes a comparison with a literal
+    if( is_null ) rest.push_back(compile_null_test(c, cond.op_ == op_eq));
+    else if( schema.kinds_[c] == col_string ){
+      std::string high = cond.op_ == op_between ? boost::get<std::string>(cond.high_) : std::string();
+      rest.push_back(compile_string_compare(c, compare_of(cond.op_), boost::get<std::string>(cond.value_), high));
+    }
+    bound.conds_.push_back(b);
+  }
+  bound.rest_ = compile_and(std::move(rest));
+  return bound;
+}
+
+//the block statistics can rule a whole block out before any of its rows is read
+bool block_may_match(bound_conditions const& conds, table_block const& block){
+  for(auto& cond : conds.conds_){
+    column_chunk const& col = block.columns_[cond.column_];
+    bool all_null = col.null_count_ == block.rows_;
+    if( boost::get<null>(&cond.value_) ){
+      if( cond.op_ == op_eq ? col.null_count_ == 0 : all_null ) return false;
+      continue;
+    }
+    if( all_null ) return false;
+    if( col.kind_ != col_int ) continue;
+    if( cond.op_ == op_neq ){
+      if( col.min_ == cond.lo_ && col.max_ == cond.lo_ ) return false;
+      continue;
+    }
+    if( cond.lo_ > cond.hi_ || cond.hi_ < col.min_ || cond.lo_ > col.max_ ) return false;
+  }
+  return true;
+}
+
+//the rows of a block left to scan, [begin_, end_)
+struct row_span{
+  std::size_t begin_;
+  std::size_t end_;
+};
+
+/*
+None when the statistics rule the block out. On a sorted column (column_chunk::sorted_) the rows
+passing a comparison form one run, found by binary search: the span is cut down to it, starting
+from a multiple of 128 as select_batch wants. The rows of the span are still checked one by one.
+*/
+row_span candidate_rows(bound_conditions const& conds, table_block const& block){
+  if( !block_may_match(conds, block) ) return row_span{0, 0};
+  row_span span{0, block.rows_};
+  for(auto& cond : conds.conds_){
+    column_chunk const& col = block.columns_[cond.column_];
+    if( !col.sorted_ || cond.op_ == op_neq || boost::get<null>(&cond.value_) ) continue;
+    span.begin_ = std::max(span.begin_, col.ints_.bound(cond.lo_, false));
+    span.end_ = std::min(span.end_, col.ints_.bound(cond.hi_, true));
+  }
+  if( span.begin_ >= span.end_ ) return row_span{0, 0};
+  span.begin_ -= span.begin_ % pack_group;
+  return span;
+}
+
+const std::size_t filter_batch_rows = 1024;
+
+/*
+Appends the rows of [from, from + n) passing every condition, from a multiple of 128 and
+n <= filter_batch_rows. Comparisons of int columns with a literal (==, !=, the ranges) run a batch
+at a time on the (compressed) column into a bitmap, the compiled remaining conditions narrow the
+surviving rows only.
+*/
+void select_batch(bound_conditions const& conds, table_block const& block, std::size_t from, std::size_t n,
+                  std::vector<std::uint32_t>& rows){
+  std::uint64_t mask[filter_batch_rows / 64], bits[filter_batch_rows / 64];
+  std::size_t words = (n + 63) / 64;
+  std::fill(mask, mask + words, ~std::uint64_t(0));
+  if( n & 63 ) mask[words - 1] = (std::uint64_t(1) << (n & 63)) - 1;
+
+  for(auto& cond : conds.conds_){
+    column_chunk const& col = block.columns_[cond.column_];
+    if( col.kind_ != col_int || boost::get<null>(&cond.value_) ) continue;
+    col.ints_.match(cond.lo_, cond.hi_, from, n, bits);
+    for(std::size_t w = 0; w < words; ++w){
+      std::uint64_t valid = col.validity_.empty() ? ~std::uint64_t(0) : col.validity_[from / 64 + w];
+      mask[w] &= (cond.op_ == op_neq ? ~bits[w] : bits[w]) & valid;
+    }
+  }
+
+  std::size_t first = rows.size();
+  for(std::size_t w = 0; w < words; ++w){
+    for(std::uint64_t m = mask[w]; m; m &= m - 1){
+      rows.push_back(static_cast<std::uint32_t>(from + w * 64 + __builtin_ctzll(m)));
+    }
+  }
+  if( conds.rest_ ) conds.rest_->filter(block, rows, first);
+}
+
+//matching row ids of every block, in table order
+using selection = std::vector<std::vector<std::uint32_t>>;
+
+/*
+Workers claim blocks in table order. Once the blocks scanned so far hold "needed" matching rows
+nobody claims a new block: the claimed blocks always form a prefix of the table, so the first
+"needed" matches of the prefix are exactly the first "needed" matches of the table.
+A single block stops as soon as it alone holds "needed" rows, for the same reason.
+Without a limit every block is needed and the order does not matter: the scan is shared with the
+other queries scanning the table (see sql_shared_scan.hpp).
+*/
+selection filter_blocks(table_data const& table, bound_conditions const& conds, std::size_t needed){
+  std::size_t blocks = table.blocks_.size();
+  selection sel(blocks);
+  if( needed == 0 ) return sel;
+
+  std::atomic<std::size_t> produced(0);
+  auto filter = [&](unsigned, std::size_t b){
+    table_block const& block = *table.blocks_[b];
+    row_span span = candidate_rows(conds, block);
+    std::vector<std::uint32_t>& rows = sel[b];
+    for(std::size_t start = span.begin_; start < span.end_ && rows.size() < needed && !query_stopped(); start += filter_batch_rows){
+      select_batch(conds, block, start, std::min(filter_batch_rows, span.end_ - start), rows);
+    }
+    if( rows.size() > needed ) rows.resize(needed);
+    return (produced += rows.size()) < needed;
+  };
+  if( needed == std::numeric_limits<std::size_t>::max() ) scan_blocks(table, filter);
+  else run_morsels(workers_for(blocks), blocks, filter);
+  return sel;
+}
+
+//a row of the table: block index and row inside the block
+struct row_ref{
+  std::uint32_t block_;
+  std::uint32_t row_;
+};
+
+std::vector<row_ref> flatten(selection const& sel){
+  std::vector<row_ref> refs;
+  for(std::size_t b = 0; b < sel.size(); ++b){
+    check_query();
+    for(auto r : sel[b]){ refs.push_back(row_ref{static_cast<std::uint32_t>(b), r}); }
+  }
+  return refs;
+}
+
+//an order by key with its column resolved
+struct bound_order{
+  int column_;
+  basic_direction direction_;
+};
+
+using bound_orders = std::vector<bound_order>;
+
+bound_orders bind_orders(table_schema const& schema, basic_orders const& orders){
+  bound_orders bound;
+  for(auto& order : orders){ bound.push_back(bound_order{schema.at(plain_column(order.column_)), order.direction_}); }
+  return bound;
+}
+
+//orders rows by the order by keys, nulls first, ties keep the table order
+struct row_less{
+  table_data const* table_;
+  bound_orders const* orders_;
+
+  bool operator()(row_ref a, row_ref b) const {
+    for(auto& order : *orders_){
+      column_chunk const& ca = table_->blocks_[a.block_]->columns_[order.column_];
+      column_chunk const& cb = table_->blocks_[b.block_]->columns_[order.column_];
+      bool na = ca.null_at(a.row_), nb = cb.null_at(b.row_);
+      int c = (na || nb) ? (na == nb ? 0 : (na ? -1 : 1))
+            : (ca.kind_ == col_int)
+            ? (ca.ints_[a.row_] < cb.ints_[b.row_] ? -1 : cb.ints_[b.row_] < ca.ints_[a.row_])
+            : ca.strings_.get(a.row_).compare(cb.strings_.get(b.row_));
+      if( c ) return order.direction_ == dir_asc ? c < 0 : c > 0;
+    }
+    return a.block_ != b.block_ ? a.block_ < b.block_ : a.row_ < b.row_;
+  }
+};
+
+//ORDER BY ... LIMIT: a bounded heap per worker, the worker heaps are merged at the end; the blocks
+//come through the shared scan of the table
+std::vector<row_ref> top_rows(table_data const& table, bound_conditions const& conds, row_less cmp, std::size_t k){
+  std::size_t blocks = table.blocks_.size();
+  unsigned workers = workers_for(blocks);
+  std::vector<bounded_heap<row_ref, row_less>> heaps(workers, bounded_heap<row_ref, row_less>(k, cmp));
+  if( k == 0 ) return {};
+
+  scan_blocks(table, [&](unsigned w, std::size_t b){
+    table_block const& block = *table.blocks_[b];
+    row_span span = candidate_rows(conds, block);
+    std::vector<std::uint32_t> rows;
+    for(std::size_t start = span.begin_; start < span.end_ && !query_stopped(); start += filter_batch_rows){
+      rows.clear();
+      select_batch(conds, block, start, std::min(filter_batch_rows, span.end_ - start), rows);
+      for(auto r : rows){ heaps[w].push(row_ref{static_cast<std::uint32_t>(b), r}); }
+    }
+    return true;
+  });
+
+  std::vector<std::vector<row_ref>> lists;
+  for(auto& heap : heaps){ lists.push_back(heap.take_sorted()); }
+  return merge_top_k(lists, k, cmp);
+}
+
+/*
+ORDER BY without a limit sorts row references, never the rows themselves.
+When the first key is an int column the references are radix sorted as (key, position) pairs,
+the remaining keys only have to order the runs of equal first keys.
+Anything else goes through the parallel merge sort.
+*/
+std::vector<row_ref> sorted_rows(table_data const& table, bound_conditions const& conds, row_less cmp){
+  std::vector<row_ref> refs = flatten(filter_blocks(table, conds, std::numeric_limits<std::size_t>::max()));
+
+  bound_order const& first = cmp.orders_->front();
+  bool nulls = std::any_of(table.blocks_.begin(), table.blocks_.end(), [&](block_ptr const& b){ return b->columns_[first.column_].null_count_ > 0; });
+  if( table.schema_.kinds_[first.column_] != col_int || nulls || refs.size() > std::numeric_limits<std::uint32_t>::max() ){
+    parallel_sort(refs, cmp);
+    return refs;
+  }
+
+  //order preserving key: flip the sign bit, complement for descending
+  std::uint32_t flip = (first.direction_ == dir_asc) ? 0x80000000u : 0x7fffffffu;
+  std::vector<std::uint64_t> items(refs.size());
+  unsigned workers = workers_for(refs.size() / 4096);
+  run_workers(workers, [&](unsigned w){
+    for(std::size_t i = refs.size() * w / workers; i < refs.size() * (w + 1) / workers; ++i){
+      if( query_stopped_at(i) ) return;
+      std::uint32_t key = static_cast<std::uint32_t>(table.blocks_[refs[i].block_]->columns_[first.column_].ints_[refs[i].row_]) ^ flip;
+      items[i] = (std::uint64_t(key) << 32) | i;
+    }
+  });
+  parallel_radix_sort(items);
+
+  std::vector<row_ref> out(refs.size());
+  for(std::size_t i = 0; i < items.size(); ++i){
+    if( query_stopped_at(i) ) check_query();
+    out[i] = refs[items[i] & 0xffffffffu];
+  }
+
+  if( cmp.orders_->size() > 1 ){
+    std::vector<std::pair<std::size_t, std::size_t>> runs;
+    for(std::size_t lo = 0, hi; lo < items.size(); lo = hi){
+      for(hi = lo + 1; hi < items.size() && (items[hi] >> 32) == (items[lo] >> 32); ++hi);
+      if( hi - lo > 1 ) runs.emplace_back(lo, hi);
+    }
+    run_morsels(workers_for(runs.size()), runs.size(), [&](unsigned, std::size_t i){
+      interruptible_sort(out.begin() + runs[i].first, out.begin() + runs[i].second, cmp);
+      return true;
+    });
+  }
+  return out;
+}
+
+/*
+Late materialization: the conditions ran on their own columns only, the selected columns are read
+for the rows left, a column at a time: out[i][k] = column columns[k] at rows[i] of the block, every
+out[i] sized for the columns. Int columns gather the rows straight from the (compressed) column.
+*/
+void gather_cells(table_block const& block, std::vector<int> const& columns, std::vector<std::uint32_t> const& rows,
+                  std::vector<result_value>* out){
+  std::vector<int> ints;
+  for(std::size_t k = 0; k < columns.size(); ++k){
+    column_chunk const& col = block.columns_[columns[k]];
+    if( col.kind_ == col_int ){
+      ints.resize(rows.size());
+      col.ints_.gather(rows.data(), rows.size(), ints.data());
+    }
+    for(std::size_t i = 0; i < rows.size(); ++i){
+      if( col.null_at(rows[i]) ) out[i][k] = null();
+      else if( col.kind_ == col_int ) out[i][k] = static_cast<long long>(ints[i]);
+      else out[i][k] = col.strings_.get(rows[i]).to_string();
+    }
+  }
+}
+
+//null sorts first
+int compare_values(result_value const& a, result_value const& b){
+  if( a.which() != b.which() ) return a.which() < b.which() ? -1 : 1;
+  if( auto x = boost::get<long long>(&a) ){
+    long long y = boost::get<long long>(b);
+    return *x < y ? -1 : y < *x;
+  }
+  if( auto x = boost::get<std::string>(&a) ) return x->compare(boost::get<std::string>(b));
+  return 0;
+}
+
+void apply_limit(std::vector<std::vector<result_value>>& rows, boost::optional<basic_limit> const& limit){
+  if( !limit ) return;
+  std::size_t offset = std::min<std::size_t>(limit->offset_, rows.size());
+  rows.erase(rows.begin(), rows.begin() + offset);
+  if( rows.size() > limit->count_ ) rows.resize(limit->count_);
+}
+
+//aggregation
+
+//an aggregate with its column resolved, column_ is -1 for COUNT(*)
+struct bound_aggregate{
+  basic_aggregate_fn fn_;
+  int column_;
+};
+
+std::int64_t aggregate_init(basic_aggregate_fn fn){
+  switch( fn ){
+    case agg_min: return std::numeric_limits<std::int64_t>::max();
+    case agg_max: return std::numeric_limits<std::int64_t>::min();
+    default: return 0;
+  }
+}
+
+//the partial aggregates of one worker: rows per group plus one state array per aggregate,
+//indexed by group id (COUNT(*) is answered from the row counts, APPROX_COUNT_DISTINCT keeps a
+//sketch per group instead); nulls are left out of the aggregates over a column
+struct agg_partial{
+  group_table groups_;
+  std::vector<std::int64_t> counts_;
+  std::vector<std::vector<std::int64_t>> states_;
+  std::vector<std::vector<std::int64_t>> summed_;   //SUM: the non null values added, none means a null sum
+  std::vector<std::vector<hll_sketch>> sketches_;
+
+  void resize(std::size_t groups, std::vector<bound_aggregate> const& aggs){
+    if( groups <= counts_.size() ) return;
+    counts_.resize(groups, 0);
+    states_.resize(aggs.size());
+    summed_.resize(aggs.size());
+    sketches_.resize(aggs.size());
+    for(std::size_t a = 0; a < aggs.size(); ++a){
+      if( aggs[a].fn_ == agg_approx_count_distinct ) sketches_[a].resize(groups);
+      else states_[a].resize(groups, aggregate_init(aggs[a].fn_));
+      if( aggs[a].fn_ == agg_sum ) summed_[a].resize(groups, 0);
+    }
+  }
+
+  void combine(std::uint32_t g, agg_partial const& other, std::uint32_t og, std::vector<bound_aggregate> const& aggs){
+    counts_[g] += other.counts_[og];
+    for(std::size_t a = 0; a < aggs.size(); ++a){
+      if( aggs[a].fn_ == agg_approx_count_distinct ){
+        sketches_[a][g].merge(other.sketches_[a][og]);
+        continue;
+      }
+      std::int64_t& st = states_[a][g];
+      std::int64_t ost = other.states_[a][og];
+      switch( aggs[a].fn_ ){
+        case agg_sum: summed_[a][g] += other.summed_[a][og]; st += ost; break;
+        case agg_count: st += ost; break;
+        case agg_min: st = std::min(st, ost); break;
+        case agg_max: st = std::max(st, ost); break;
+        default: break;
+      }
+    }
+  }
+};
+
+/*
+Group ids are either
+  direct: key - base_, when there is no GROUP BY (one group) or a single int key whose range
+          (from the block statistics) is small; the partials are then plain arrays
+  hashed: the serialized key looked up in the worker's group_table
+*/
+struct group_plan{
+  std::vector<int> keys_;
+  std::vector<bound_aggregate> aggs_;
+  bool direct_;
+  int base_;
+  std::size_t range_;
+};
+
+const std::size_t direct_group_limit = 64 * 1024;
+const std::size_t agg_batch_rows = 1024;
+
+group_plan plan_groups(table_data const& table, basic_select const& select){
+  table_schema const& schema = table.schema_;
+  group_plan plan;
+  if( select.group_by_ ){
+    for(auto& field : *select.group_by_){ plan.keys_.push_back(schema.at(field)); }
+  }
+  for(auto& column : select.columns_){
+    if( auto agg = boost::get<basic_aggregate>(&column) ){
+      int c = (agg->field_ == "*") ? -1 : schema.at(agg->field_);
+      if( c < 0 && agg->fn_ != agg_count ) throw std::runtime_error("only COUNT takes *");
+      if( c >= 0 && agg->fn_ != agg_count && agg->fn_ != agg_approx_count_distinct && schema.kinds_[c] != col_int )
+        throw std::runtime_error("SUM/MIN/MAX need an int column: " + agg->field_);
+      plan.aggs_.push_back(bound_aggregate{agg->fn_, c});
+    }else if( std::find(plan.keys_.begin(), plan.keys_.end(), schema.at(plain_column(column))) == plan.keys_.end() ){
+      throw std::runtime_error("column is neither grouped nor aggregated: " + plain_column(column));
+    }
+  }
+
+  plan.direct_ = plan.keys_.empty();
+  plan.base_ = 0;
+  plan.range_ = 1;
+  bool nulls = !plan.keys_.empty() && std::any_of(table.blocks_.begin(), table.blocks_.end(),
+                                                  [&](block_ptr const& b){ return b->columns_[plan.keys_[0]].null_count_ > 0; });
+  if( plan.keys_.size() == 1 && schema.kinds_[plan.keys_[0]] == col_int && !table.blocks_.empty() && !nulls ){
+    long long lo = std::numeric_limits<int>::max(), hi = std::numeric_limits<int>::min();
+    for(auto& block : table.blocks_){
+      lo = std::min<long long>(lo, block->columns_[plan.keys_[0]].min_);
+      hi = std::max<long long>(hi, block->columns_[plan.keys_[0]].max_);
+    }
+    if( hi - lo < static_cast<long long>(direct_group_limit) ){
+      plan.direct_ = true;
+      plan.base_ = static_cast<int>(lo);
+      plan.range_ = static_cast<std::size_t>(hi - lo + 1);
+    }
+  }
+  return plan;
+}
+
+//key layout: 1 byte null flag, then int -> 4 bytes, string -> 4 bytes length + bytes
+void encode_key(table_block const& block, std::uint32_t row, std::vector<int> const& keys, std::string& out){
+  for(auto c : keys){
+    column_chunk const& col = block.columns_[c];
+    bool is_null = col.null_at(row);
+    out.push_back(is_null ? 1 : 0);
+    if( is_null ) continue;
+    if( col.kind_ == col_int ){
+      int v = col.ints_[row];
+      out.append(reinterpret_cast<char const*>(&v), sizeof(v));
+    }else{
+      boost::string_ref s = col.strings_.get(row);
+      std::uint32_t n = static_cast<std::uint32_t>(s.size());
+      out.append(reinterpret_cast<char const*>(&n), sizeof(n));
+      out.append(s.data(), s.size());
+    }
+  }
+}
+
+std::vector<result_value> decode_key(table_schema const& schema, std::vector<int> const& keys, boost::string_ref key){
+  std::vector<result_value> values;
+  char const* p = key.data();
+  for(auto c : keys){
+    if( *p++ ){
+      values.push_back(null());
+      continue;
+    }
+    if( schema.kinds_[c] == col_int ){
+      int v;
+      std::memcpy(&v, p, sizeof(v));
+      p += sizeof(v);
+      values.push_back(static_cast<long long>(v));
+    }else{
+      std::uint32_t n;
+      std::memcpy(&n, p, sizeof(n));
+      p += sizeof(n);
+      values.push_back(std::string(p, n));
+      p += n;
+    }
+  }
+  return values;
+}
+
+//hashes a batch of values, then feeds them to the sketches of their groups
+void sketch_batch(std::vector<hll_sketch>& sketches, column_chunk const& col, std::vector<std::uint32_t> const& rows,
+                  std::vector<std::uint32_t> const& groups, std::vector<std::uint64_t>& hashes, std::vector<int>& values){
+  std::size_t n = rows.size();
+  hashes.resize(n);
+  if( n == 0 ) return;
+  if( col.kind_ == col_int ){
+    std::uint32_t lo = rows.front();
+    int const* ints = col.ints_.span(lo, rows.back() - lo + 1, values);
+    for(std::size_t i = 0; i < n; ++i){ hashes[i] = hash_int(static_cast<std::uint32_t>(ints[rows[i] - lo])); }
+  }else{
+    for(std::size_t i = 0; i < n; ++i){ hashes[i] = hash_bytes(col.strings_.get(rows[i])); }
+  }
+  if( sketches.size() == 1 ){
+    sketches[0].add_hashes(hashes.data(), n);
+    return;
+  }
+  for(std::size_t i = 0; i < n; ++i){ sketches[groups[i]].add_hash(hashes[i]); }
+}
+
+//per worker buffers of the batches
+struct agg_scratch{
+  std::vector<std::uint32_t> rows_, groups_;
+  std::vector<std::uint32_t> valid_rows_, valid_groups_;
+  std::vector<std::uint64_t> hashes_;
+  std::vector<int> values_;
+  key_batch keys_;
+};
+
+//one batch of matching rows: find their groups, then update the aggregates one array at a time;
+//int columns are decoded once for the span of rows the batch covers
+void aggregate_batch(agg_partial& part, group_plan const& plan, table_block const& block, agg_scratch& scratch){
+  std::vector<std::uint32_t> const& rows = scratch.rows_;
+  std::vector<std::uint32_t>& groups = scratch.groups_;
+  key_batch& keys = scratch.keys_;
+  std::size_t n = rows.size();
+  if( n == 0 ) return;
+  std::uint32_t lo = rows.front();
+  std::size_t span = rows.back() - lo + 1;
+  groups.resize(n);
+  if( plan.direct_ ){
+    if( plan.keys_.empty() ) std::fill(groups.begin(), groups.end(), 0);
+    else{
+      int const* ints = block.columns_[plan.keys_[0]].ints_.span(lo, span, scratch.values_);
+      for(std::size_t i = 0; i < n; ++i){ groups[i] = static_cast<std::uint32_t>(ints[rows[i] - lo] - plan.base_); }
+    }
+  }else{
+    keys.clear();
+    for(std::size_t i = 0; i < n; ++i){
+      encode_key(block, rows[i], plan.keys_, keys.bytes_);
+      keys.end_key();
+    }
+    part.groups_.find_or_insert(keys, groups.data());
+    part.resize(part.groups_.size(), plan.aggs_);
+  }
+
+  for(std::size_t i = 0; i < n; ++i){ ++part.counts_[groups[i]]; }
+  for(std::size_t a = 0; a < plan.aggs_.size(); ++a){
+    bound_aggregate const& agg = plan.aggs_[a];
+    if( agg.column_ < 0 ) continue;
+
+    //the rows of the batch where the aggregated column is not null
+    column_chunk const& col = block.columns_[agg.column_];
+    std::vector<std::uint32_t> const* arows = &rows;
+    std::vector<std::uint32_t> const* agroups = &groups;
+    if( col.null_count_ ){
+      scratch.valid_rows_.clear();
+      scratch.valid_groups_.clear();
+      for(std::size_t i = 0; i < n; ++i){
+        if( col.null_at(rows[i]) ) continue;
+        scratch.valid_rows_.push_back(rows[i]);
+        scratch.valid_groups_.push_back(groups[i]);
+      }
+      arows = &scratch.valid_rows_;
+      agroups = &scratch.valid_groups_;
+    }
+
+    if( agg.fn_ == agg_approx_count_distinct ){
+      sketch_batch(part.sketches_[a], col, *arows, *agroups, scratch.hashes_, scratch.values_);
+      continue;
+    }
+    std::size_t m = arows->size();
+    std::uint32_t const* r = arows->data();
+    std::uint32_t const* g = agroups->data();
+    std::int64_t* st = part.states_[a].data();
+    if( agg.fn_ == agg_count ){
+      for(std::size_t i = 0; i < m; ++i){ ++st[g[i]]; }
+      continue;
+    }
+    int const* ints = col.ints_.span(lo, span, scratch.values_);
+    switch( agg.fn_ ){
+      case agg_sum: {
+        std::int64_t* summed = part.summed_[a].data();
+        for(std::size_t i = 0; i < m; ++i){
+          st[g[i]] += ints[r[i] - lo];
+          ++summed[g[i]];
+        }
+        break;
+      }
+      case agg_min: for(std::size_t i = 0; i < m; ++i){ st[g[i]] = std::min<std::int64_t>(st[g[i]], ints[r[i] - lo]); } break;
+      case agg_max: for(std::size_t i = 0; i < m; ++i){ st[g[i]] = std::max<std::int64_t>(st[g[i]], ints[r[i] - lo]); } break;
+      default: break;
+    }
+  }
+}
+
+//every worker aggregates its blocks into its own partial, the blocks come through the shared scan
+std::vector<agg_partial> aggregate_partials(table_data const& table, bound_conditions const& conds, group_plan const& plan){
+  std::size_t blocks = table.blocks_.size();
+  unsigned workers = workers_for(blocks);
+  std::vector<agg_partial> partials(workers);
+  if( plan.direct_ ){
+    for(auto& part : partials){ part.resize(plan.range_, plan.aggs_); }
+  }
+
+  scan_blocks(table, [&](unsigned w, std::size_t b){
+    table_block const& block = *table.blocks_[b];
+    row_span span = candidate_rows(conds, block);
+    if( span.begin_ == span.end_ ) return true;
+    agg_scratch scratch;
+    scratch.rows_.reserve(agg_batch_rows);
+    for(std::size_t start = span.begin_; start < span.end_ && !query_stopped(); start += agg_batch_rows){
+      scratch.rows_.clear();
+      select_batch(conds, block, start, std::min(agg_batch_rows, span.end_ - start), scratch.rows_);
+      aggregate_batch(partials[w], plan, block, scratch);
+    }
+    return true;
+  });
+  return partials;
+}
+
+//the hashed partials are merged in parallel: merge worker p owns the groups whose hash falls in partition p
+std::vector<agg_partial> merge_partials(std::vector<agg_partial> partials, group_plan const& plan){
+  if( partials.size() == 1 ) return partials;
+  if( plan.direct_ ){
+    for(std::size_t w = 1; w < partials.size(); ++w){
+      for(std::uint32_t g = 0; g < plan.range_; ++g){ partials[0].combine(g, partials[w], g, plan.aggs_); }
+    }
+    partials.resize(1);
+    return partials;
+  }
+
+  unsigned parts = static_cast<unsigned>(partials.size());
+  std::vector<agg_partial> merged(parts);
+  run_workers(parts, [&](unsigned p){
+    agg_partial& out = merged[p];
+    for(auto& part : partials){
+      for(std::uint32_t g = 0; g < part.groups_.size(); ++g){
+        std::uint64_t h = part.groups_.hash(g);
+        if( (h >> 40) % parts != p ) continue;
+        std::uint32_t og = out.groups_.find_or_insert(part.groups_.key(g), h);
+        out.resize(out.groups_.size(), plan.aggs_);
+        out.combine(og, part, g, plan.aggs_);
+      }
+    }
+  });
+  return merged;
+}
+
+result_set execute_grouped(table_data const& table, basic_select const& select){
+  group_plan plan = plan_groups(table, select);
+  bound_conditions conds = bind_conditions(table.schema_, select.conditions_);
+
+  std::vector<agg_partial> merged = merge_partials(aggregate_partials(table, conds, plan), plan);
+
+  result_set rs;
+  for(auto& column : select.columns_){ rs.names_.push_back(column_label(column)); }
+
+  //without ORDER BY any offset + count groups will do
+  std::size_t wanted = std::numeric_limits<std::size_t>::max();
+  if( select.limit_ && !select.orders_ ) wanted = std::size_t(select.limit_->offset_) + select.limit_->count_;
+
+  for(auto& part : merged){
+    std::size_t groups = plan.direct_ ? plan.range_ : part.groups_.size();
+    for(std::uint32_t g = 0; g < groups && rs.rows_.size() < wanted; ++g){
+      if( part.counts_[g] == 0 && !plan.keys_.empty() ) continue;
+
+      std::vector<result_value> key = plan.direct_
+        ? (plan.keys_.empty() ? std::vector<result_value>() : std::vector<result_value>(1, static_cast<long long>(plan.base_) + g))
+        : decode_key(table.schema_, plan.keys_, part.groups_.key(g));
+
+      std::vector<result_value> row;
+      std::size_t a = 0;
+      for(auto& column : select.columns_){
+        if( !is_aggregate(column) ){
+          int c = table.schema_.at(plain_column(column));
+          row.push_back(key[std::find(plan.keys_.begin(), plan.keys_.end(), c) - plan.keys_.begin()]);
+          continue;
+        }
+        bound_aggregate const& agg = plan.aggs_[a];
+        std::int64_t st = agg.fn_ == agg_approx_count_distinct ? 0 : part.states_[a][g];
+        if( agg.fn_ == agg_count ) row.push_back(static_cast<long long>(agg.column_ < 0 ? part.counts_[g] : st));
+        else if( agg.fn_ == agg_approx_count_distinct ) row.push_back(std::llround(part.sketches_[a][g].estimate()));
+        else if( agg.fn_ == agg_sum ? part.summed_[a][g] == 0 : st == aggregate_init(agg.fn_) ) row.push_back(null());
+        else row.push_back(static_cast<long long>(st));
+        ++a;
+      }
+      rs.rows_.push_back(std::move(row));
+    }
+  }
+
+  //ORDER BY over the groups: every key has to be one of the selected columns
+  if( select.orders_ ){
+    std::vector<std::pair<std::size_t, basic_direction>> keys;
+    for(auto& order : *select.orders_){
+      std::string label = column_label(order.column_);
+      std::size_t i = 0;
+      while( i < rs.names_.size() && !boost::iequals(rs.names_[i], label) ){ ++i; }
+      if( i == rs.names_.size() ) throw std::runtime_error("ORDER BY of a grouped select must name a selected column: " + label);
+      keys.emplace_back(i, order.direction_);
+    }
+    std::stable_sort(rs.rows_.begin(), rs.rows_.end(), [&](std::vector<result_value> const& x, std::vector<result_value> const& y){
+      for(auto& key : keys){
+        int c = compare_values(x[key.first], y[key.first]);
+        if( c ) return key.second == dir_asc ? c < 0 : c > 0;
+      }
+      return false;
+    });
+  }
+  apply_limit(rs.rows_, select.limit_);
+  return rs;
+}
+
+//applies rename to every column name used by the select
+template<typename F>
+void rename_columns(basic_select& select, F rename){
+  auto column = [&](basic_column& c){
+    if( auto name = boost::get<std::string>(&c) ) *name = rename(*name);
+    else{
+      basic_aggregate& agg = boost::get<basic_aggregate>(c);
+      if( agg.field_ != "*" ) agg.field_ = rename(agg.field_);
+    }
+  };
+  for(auto& c : select.columns_){ column(c); }
+  if( select.conditions_ ) for(auto& cond : *select.conditions_){ cond.field_ = rename(cond.field_); }
+  if( select.group_by_ ) for(auto& field : *select.group_by_){ field = rename(field); }
+  if( select.orders_ ) for(auto& order : *select.orders_){ column(order.column_); }
+}
+
+result_set execute_on(table_data const& table, basic_select const& select){
+  if( select.group_by_ || std::any_of(select.columns_.begin(), select.columns_.end(), is_aggregate) )
+    return execute_grouped(table, select);
+
+  result_set rs;
+  std::vector<int> columns;
+  for(auto& column : select.columns_){
+    columns.push_back(table.schema_.at(plain_column(column)));
+    rs.names_.push_back(plain_column(column));
+  }
+
+  bound_conditions conds = bind_conditions(table.schema_, select.conditions_);
+
+  std::size_t offset = select.limit_ ? select.limit_->offset_ : 0;
+  std::size_t count = select.limit_ ? select.limit_->count_ : std::numeric_limits<std::size_t>::max() - offset;
+
+  std::vector<row_ref> refs;
+  if( select.orders_ ){
+    bound_orders orders = bind_orders(table.schema_, *select.orders_);
+    row_less cmp{&table, &orders};
+    refs = select.limit_ ? top_rows(table, conds, cmp, offset + count) : sorted_rows(table, conds, cmp);
+  }else{
+    refs = flatten(filter_blocks(table, conds, offset + count));
+  }
+
+  //the rows kept, cut into runs of the same block, each run gathered a column at a time
+  std::size_t end = offset < refs.size() ? offset + std::min(count, refs.size() - offset) : offset;
+  std::vector<std::pair<std::size_t, std::size_t>> runs;
+  for(std::size_t i = offset; i < end; ){
+    std::size_t j = i + 1;
+    while( j < end && refs[j].block_ == refs[i].block_ ){ ++j; }
+    runs.emplace_back(i, j);
+    i = j;
+  }
+  rs.rows_.assign(end - offset, std::vector<result_value>(columns.size()));
+  run_morsels(workers_for(runs.size()), runs.size(), [&](unsigned, std::size_t m){
+    std::vector<std::uint32_t> rows;
+    for(std::size_t i = runs[m].first; i < runs[m].second; ++i){ rows.push_back(refs[i].row_); }
+    gather_cells(*table.blocks_[refs[runs[m].first].block_], columns, rows, &rs.rows_[runs[m].first - offset]);
+    return true;
+  });
+  return rs;
+}
+
+//the FROM table, or its TABLESAMPLE sample (see sql_sample.hpp) kept in storage
+table_data const& from_table(database const& db, basic_select const& select, table_data& storage){
+  table_data const& table = find_table(db, select.table_);
+  if( !select.sample_ ) return table;
+
+  basic_sample const& sample = *select.sample_;
+  if( sample.amount_ < 0 || (sample.unit_ == unit_percent && sample.amount_ > 100) )
+    throw std::runtime_error("TABLESAMPLE takes 0 to 100 PERCENT or a positive number of ROWS");
+  storage = (sample.unit_ == unit_percent)
+          ? sample_percent(table, sample.amount_, sample.seed_)
+          : sample_rows(table, static_cast<std::size_t>(sample.amount_), sample.seed_);
+  return storage;
+}
+
+//one input of a join: the table, the conditions on its columns and the rows passing them
+struct join_input{
+  table_data const* table_;
+  basic_table name_;
+  basic_conditions conditions_;
+  std::vector<row_ref> rows_;
 };
 
-//g++ file.cpp -std=c++11
+/*
+FROM a JOIN b ON a.x == b.y:
+  - every condition compares one column with a literal, so it is pushed down to its table
+  - the smaller filtered input is the build side of the partitioned hash join (sql_hash_join.hpp),
+    with the bloom prefilter on when the probe side is the bigger one
+  - only the columns the select uses are materialized into a joined table, named table.column,
+    and the rest of the select runs against it as usual
+*/
+result_set execute_join(database const& db, basic_select const& select){
+  basic_join const& join = *select.join_;
+  table_data sample;
+  join_input sides[2] = {
+    join_input{&from_table(db, select, sample), select.table_, {}, {}},
+    join_input{&find_table(db, join.table_), join.table_, {}, {}}
+  };
+  if( boost::iequals(sides[0].name_, sides[1].name_) ) throw std::runtime_error("a table can not be joined with itself");
+
+  //(side, column) of a possibly qualified column name
+  auto resolve = [&](std::string const& name) -> std::pair<int, int> {
+    std::size_t dot = name.find('.');
+    if( dot != std::string::npos ){
+      std::string table = name.substr(0, dot);
+      for(int s = 0; s < 2; ++s){
+        if( boost::iequals(sides[s].name_, table) ) return std::make_pair(s, sides[s].table_->schema_.at(name.substr(dot + 1)));
+      }
+      throw std::runtime_error("unknown table: " + table);
+    }
+    int l = sides[0].table_->schema_.find(name), r = sides[1].table_->schema_.find(name);
+    if( l >= 0 && r >= 0 ) throw std::runtime_error("ambiguous column: " + name);
+    if( l < 0 && r < 0 ) throw std::runtime_error("unknown column: " + name);
+    return l >= 0 ? std::make_pair(0, l) : std::make_pair(1, r);
+  };
+
+  if( select.conditions_ ){
+    for(auto& cond : *select.conditions_){
+      std::pair<int, int> at = resolve(cond.field_);
+      basic_condition pushed = cond;
+      pushed.field_ = sides[at.first].table_->schema_.names_[at.second];
+      sides[at.first].conditions_.push_back(pushed);
+    }
+  }
+
+  std::pair<int, int> keys[2] = { resolve(join.left_), resolve(join.right_) };
+  if( keys[0].first == keys[1].first ) throw std::runtime_error("the join condition has to compare the two tables");
+  if( keys[0].first == 1 ) std::swap(keys[0], keys[1]);
+  column_kind kind = sides[0].table_->schema_.kinds_[keys[0].second];
+  if( kind != sides[1].table_->schema_.kinds_[keys[1].second] ) throw std::runtime_error("the join columns have different types");
+
+  //a null key joins nothing
+  for(int s = 0; s < 2; ++s){
+    join_input& side = sides[s];
+    side.rows_ = flatten(filter_blocks(*side.table_, bind_conditions(side.table_->schema_, side.conditions_),
+                                       std::numeric_limits<std::size_t>::max()));
+    check_query();
+    int key = keys[s].second;
+    side.rows_.erase(std::remove_if(side.rows_.begin(), side.rows_.end(), [&](row_ref const& r){
+                       return side.table_->blocks_[r.block_]->columns_[key].null_at(r.row_);
+                     }), side.rows_.end());
+  }
+
+  auto key_of = [&](int s, std::uint32_t i) -> column_chunk const& {
+    return sides[s].table_->blocks_[sides[s].rows_[i].block_]->columns_[keys[s].second];
+  };
+  auto tuples = [&](int s){
+    std::vector<join_tuple> out(sides[s].rows_.size());
+    unsigned workers = workers_for(out.size() / 4096);
+    run_workers(workers, [&](unsigned w){
+      for(std::size_t i = out.size() * w / workers; i < out.size() * (w + 1) / workers; ++i){
+        if( query_stopped_at(i) ) return;
+        column_chunk const& col = key_of(s, static_cast<std::uint32_t>(i));
+        std::uint32_t row = sides[s].rows_[i].row_;
+        out[i].hash_ = (kind == col_int) ? hash_int(static_cast<std::uint32_t>(col.ints_[row])) : hash_bytes(col.strings_.get(row));
+        out[i].row_ = static_cast<std::uint32_t>(i);
+      }
+    });
+    return out;
+  };
+
+  int build = sides[1].rows_.size() <= sides[0].rows_.size() ? 1 : 0;
+  int probe = 1 - build;
+  auto equal = [&](std::uint32_t p, std::uint32_t b){
+    column_chunk const& pc = key_of(probe, p);
+    column_chunk const& bc = key_of(build, b);
+    std::uint32_t pr = sides[probe].rows_[p].row_, br = sides[build].rows_[b].row_;
+    return (kind == col_int) ? pc.ints_[pr] == bc.ints_[br] : pc.strings_.get(pr) == bc.strings_.get(br);
+  };
+  std::vector<std::pair<std::uint32_t, std::uint32_t>> pairs =
+    hash_join(tuples(build), tuples(probe), equal, sides[build].rows_.size() < sides[probe].rows_.size());
+
+  //the joined table holds the used columns only
+  basic_select inner = select;
+  inner.sample_ = boost::none;
+  inner.join_ = boost::none;
+  inner.conditions_ = boost::none;
+  table_data joined;
+  std::vector<std::pair<int, int>> used;
+  rename_columns(inner, [&](std::string const& name){
+    std::pair<int, int> at = resolve(name);
+    std::string qualified = boost::to_lower_copy(sides[at.first].name_ + "." + sides[at.first].table_->schema_.names_[at.second]);
+    if( std::find(used.begin(), used.end(), at) == used.end() ){
+      used.push_back(at);
+      joined.schema_.names_.push_back(qualified);
+      joined.schema_.kinds_.push_back(sides[at.first].table_->schema_.kinds_[at.second]);
+    }
+    return qualified;
+  });
+
+  {
+    table_builder builder(joined);
+    for(std::size_t i = 0; i < pairs.size(); ++i){
+      if( query_stopped_at(i) ) check_query();
+      auto& pair = pairs[i];
+      row_ref refs[2];
+      refs[probe] = sides[probe].rows_[pair.first];
+      refs[build] = sides[build].rows_[pair.second];
+      for(std::size_t c = 0; c < used.size(); ++c){
+        int s = used[c].first;
+        column_chunk const& col = sides[s].table_->blocks_[refs[s].block_]->columns_[used[c].second];
+        if( col.null_at(refs[s].row_) ) builder.put_null(c);
+        else if( col.kind_ == col_int ) builder.put(c, col.ints_[refs[s].row_]);
+        else builder.put(c, col.strings_.get(refs[s].row_));
+      }
+      builder.end_row();
+    }
+  }
+
+  result_set rs = execute_on(joined, inner);
+  for(std::size_t c = 0; c < select.columns_.size(); ++c){ rs.names_[c] = column_label(select.columns_[c]); }
+  return rs;
+}
+
+//table.column is fine as long as it names the FROM table, without a join the table is dropped
+//table.column as column, for a statement over table only
+std::string unqualified_name(basic_table const& table, std::string const& name){
+  std::size_t dot = name.find('.');
+  if( dot == std::string::npos ) return name;
+  if( !boost::iequals(name.substr(0, dot), table) ) throw std::runtime_error("unknown table: " + name.substr(0, dot));
+  return name.substr(dot + 1);
+}
+
+basic_select unqualified(basic_select const& select){
+  basic_select local = select;
+  rename_columns(local, [&](std::string const& name){ return unqualified_name(select.table_, name); });
+  return local;
+}
+
+result_set execute(database const& db, basic_select const& select){
+  if( select.join_ ) return execute_join(db, select);
+
+  table_data sample;
+  return execute_on(from_table(db, select, sample), unqualified(select));
+}
+
+//materialized views (see sql_matview.hpp)
+
+using view_rows = materialized_view<std::vector<result_value>>;
+
+struct view_def{
+  std::string name_;
+  basic_select select_;       //the definition, as written
+  std::string text_;          //its canonical text
+  std::string table_;         //lower case
+  table_schema schema_;       //of the table when the view was created
+  std::vector<std::string> names_;
+  std::unique_ptr<view_rows> rows_;
+};
+
+std::mutex views_mutex;
+std::map<std::string, std::shared_ptr<view_def>> views; //keyed by lower case view name
+
+std::string canonical_text(basic_select const& select);
+
+std::shared_ptr<view_def> find_view(std::string const& name){
+  std::lock_guard<std::mutex> lock(views_mutex);
+  auto it = views.find(boost::to_lower_copy(name));
+  return it == views.end() ? nullptr : it->second;
+}
+
+//the view defined by exactly this select (up to the canonical text), if any
+std::shared_ptr<view_def> view_defined_by(basic_select const& select){
+  std::lock_guard<std::mutex> lock(views_mutex);
+  if( views.empty() ) return nullptr;
+  std::string text = canonical_text(select);
+  for(auto& v : views){
+    if( v.second->text_ == text ) return v.second;
+  }
+  return nullptr;
+}
+
+//the view rows, with the changed blocks of its table evaluated first
+std::shared_ptr<view_def> refreshed(database const& db, std::shared_ptr<view_def> view){
+  table_data const& table = find_table(db, view->table_);
+  if( table.schema_.names_ != view->schema_.names_ || table.schema_.kinds_ != view->schema_.kinds_ )
+    throw std::runtime_error("the columns of " + view->table_ + " changed under the view");
+  view->rows_->refresh(table);
+  return view;
+}
+
+//only SELECT columns FROM table WHERE conditions can be maintained block by block
+std::size_t create_view(database const& db, basic_create_view const& def){
+  basic_select const& select = def.select_;
+  if( select.sample_ || select.join_ || select.group_by_ || select.orders_ || select.limit_ ||
+      std::any_of(select.columns_.begin(), select.columns_.end(), is_aggregate) )
+    throw std::runtime_error("a materialized view is a SELECT columns FROM table WHERE conditions");
+  if( db.count(boost::to_lower_copy(def.name_)) ) throw std::runtime_error("there is a table named " + def.name_);
+
+  table_data const& table = find_table(db, select.table_);
+  basic_select local = unqualified(select);
+  std::shared_ptr<view_def> view(new view_def());
+  view->name_ = def.name_;
+  view->select_ = select;
+  view->text_ = canonical_text(select);
+  view->table_ = boost::to_lower_copy(select.table_);
+  view->schema_ = table.schema_;
+  std::vector<int> columns;
+  for(auto& column : local.columns_){
+    columns.push_back(table.schema_.at(plain_column(column)));
+    view->names_.push_back(plain_column(column));
+  }
+  bound_conditions conds = bind_conditions(table.schema_, local.conditions_);
+  view->rows_.reset(new view_rows([columns, conds](table_block const& block, std::vector<std::vector<result_value>>& out){
+    row_span span = candidate_rows(conds, block);
+    std::vector<std::uint32_t> rows;
+    for(std::size_t start = span.begin_; start < span.end_ && !query_stopped(); start += filter_batch_rows){
+      rows.clear();
+      select_batch(conds, block, start, std::min(filter_batch_rows, span.end_ - start), rows);
+      std::size_t first = out.size();
+      out.resize(first + rows.size(), std::vector<result_value>(columns.size()));
+      gather_cells(block, columns, rows, out.data() + first);
+    }
+  }));
+  view->rows_->refresh(table);
+
+  std::lock_guard<std::mutex> lock(views_mutex);
+  if( !views.emplace(boost::to_lower_copy(def.name_), view).second ) throw std::runtime_error("there is a view named " + def.name_);
+  return view->rows_->size();
+}
+
+//SELECT columns FROM view LIMIT count OFFSET offset reads (some of) the columns of the view
+result_set read_view(database const& db, std::shared_ptr<view_def> view, basic_select const& select){
+  if( select.sample_ || select.join_ || select.conditions_ || select.group_by_ || select.orders_ )
+    throw std::runtime_error("a view can only be read as SELECT columns FROM view LIMIT count OFFSET offset");
 
-int main( /* ... */ ){
+  result_set rs;
+  std::vector<std::size_t> columns;
+  for(auto& column : unqualified(select).columns_){
+    std::string const& name = plain_column(column);
+    std::size_t c = 0;
+    while( c < view->names_.size() && !boost::iequals(view->names_[c], name) ){ ++c; }
+    if( c == view->names_.size() ) throw std::runtime_error("unknown column: " + name);
+    columns.push_back(c);
+    rs.names_.push_back(name);
+  }
+
+  std::size_t offset = select.limit_ ? select.limit_->offset_ : 0;
+  std::size_t count = select.limit_ ? select.limit_->count_ : std::numeric_limits<std::size_t>::max();
+  std::size_t seen = 0;
+  refreshed(db, view)->rows_->read([&](std::vector<result_value> const& row){
+    if( seen++ < offset || rs.rows_.size() >= count ) return;
+    std::vector<result_value> out;
+    for(auto c : columns){ out.push_back(row[c]); }
+    rs.rows_.push_back(std::move(out));
+  });
+  return rs;
+}
+
+//result caching (see sql_result_cache.hpp)
+
+/*
+The canonical text of a select: identifiers in lower case, the conditions (a conjunction) sorted,
+string literals quoted so that 'null' and null differ. Selects that only differ in the case of
+their identifiers or in the order of their conditions get the same text.
+*/
+std::string canonical_text(basic_select const& select){
+  basic_select canon = select;
+  rename_columns(canon, [](std::string const& name){ return boost::to_lower_copy(name); });
+  boost::to_lower(canon.table_);
+  if( canon.join_ ){
+    boost::to_lower(canon.join_->table_);
+    boost::to_lower(canon.join_->left_);
+    boost::to_lower(canon.join_->right_);
+  }
+  if( canon.conditions_ ){
+    for(auto& cond : *canon.conditions_){
+      if( auto s = boost::get<std::string>(&cond.value_) ) cond.value_ = "'" + *s + "'";
+      if( auto s = boost::get<std::string>(&cond.high_) ) cond.high_ = "'" + *s + "'";
+    }
+    auto text = [](basic_condition const& cond){
+      std::ostringstream os;
+      os << basic_conditions(1, cond);
+      return os.str();
+    };
+    std::sort(canon.conditions_->begin(), canon.conditions_->end(), [&](basic_condition const& a, basic_condition const& b){
+      return text(a) < text(b);
+    });
+  }
+  std::ostringstream os;
+  os << canon;
+  return os.str();
+}
+
+std::size_t result_bytes(result_set const& rs){
+  std::size_t n = sizeof(rs);
+  for(auto& name : rs.names_){ n += sizeof(name) + name.capacity(); }
+  for(auto& row : rs.rows_){
+    n += sizeof(row) + row.capacity() * sizeof(result_value);
+    for(auto& v : row){
+      if( auto s = boost::get<std::string>(&v) ) n += s->capacity();
+    }
+  }
+  return n;
+}
+
+using select_cache = result_cache<result_set>;
+
+//null when caching is off
+std::unique_ptr<select_cache> cache(new select_cache(64 * 1024 * 1024));
+
+//execute() through the cache; the names of a cached result are the ones this select gives them
+std::shared_ptr<result_set const> execute_cached(database const& db, basic_select const& select, bool& hit){
+  hit = false;
+  //a view read by its name, or by the select defining it
+  if( !select.join_ ){
+    if( std::shared_ptr<view_def> view = find_view(select.table_) ) return std::make_shared<result_set const>(read_view(db, view, select));
+    if( std::shared_ptr<view_def> view = view_defined_by(select) ){
+      basic_select by_name;
+      by_name.columns_ = unqualified(select).columns_;
+      by_name.table_ = view->name_;
+      return std::make_shared<result_set const>(read_view(db, view, by_name));
+    }
+  }
+  if( !cache ) return std::make_shared<result_set const>(execute(db, select));
+
+  table_versions tables;
+  tables.emplace_back(boost::to_lower_copy(select.table_), find_table(db, select.table_).version_);
+  if( select.join_ ) tables.emplace_back(boost::to_lower_copy(select.join_->table_), find_table(db, select.join_->table_).version_);
+  std::string key = select_cache::key(canonical_text(select), tables);
+
+  if( std::shared_ptr<result_set const> cached = cache->find(key) ){
+    hit = true;
+    basic_select named = select.join_ ? select : unqualified(select);
+    std::shared_ptr<result_set> rs = std::make_shared<result_set>(*cached);
+    for(std::size_t c = 0; c < named.columns_.size(); ++c){
+      rs->names_[c] = column_label(named.columns_[c]);
+    }
+    return rs;
+  }
+  std::shared_ptr<result_set const> rs = std::make_shared<result_set const>(execute(db, select));
+  cache->insert(key, tables, rs, result_bytes(*rs));
+  return rs;
+}
+
+std::ostream& operator<<(std::ostream& os, result_cache_stats const& s){
+  return os << s.hits_ << " hits, " << s.misses_ << " misses, " << s.evictions_ << " evictions, " << s.invalidations_
+            << " invalidations, " << s.entries_ << " entries, " << s.bytes_ / 1024 << " KB";
+}
+
+//writes (see sql_store.hpp): the views over a table catch up on their next read, its cached results
+//are dropped at once
+
+std::shared_ptr<table_store> find_store(table_catalog const& catalog, basic_table const& name){
+  std::shared_ptr<table_store> store = catalog.find(boost::to_lower_copy(name));
+  if( !store ) throw std::runtime_error("unknown table: " + name);
+  return store;
+}
+
+//the column written by a field, with the value checked against its kind
+int written_column(table_schema const& schema, basic_table const& table, basic_field const& field, basic_value const& v){
+  int c = schema.at(unqualified_name(table, field));
+  if( (boost::get<int>(&v) && schema.kinds_[c] != col_int) || (boost::get<std::string>(&v) && schema.kinds_[c] != col_string) )
+    throw std::runtime_error("wrong kind of value for column: " + field);
+  return c;
+}
+
+void put_value(table_builder& builder, int c, basic_value const& v){
+  if( int const* i = boost::get<int>(&v) ) builder.put(c, *i);
+  else if( std::string const* str = boost::get<std::string>(&v) ) builder.put(c, *str);
+  else builder.put_null(c);
+}
+
+void written(table_catalog& catalog, basic_table const& table){
+  catalog.written();
+  if( cache ) cache->invalidate(boost::to_lower_copy(table));
+}
+
+//the rows are built into blocks of the inserting thread and appended as they are; the columns not
+//listed are null
+std::size_t execute_insert(table_catalog& catalog, basic_insert const& insert){
+  std::shared_ptr<table_store> store = find_store(catalog, insert.table_);
+  table_schema const schema = store->snapshot()->schema_;
+
+  std::vector<int> columns;
+  for(auto& row : insert.rows_){
+    if( row.size() != insert.columns_.size() ) throw std::runtime_error("wrong number of values in an inserted row");
+  }
+  for(std::size_t c = 0; c < insert.columns_.size(); ++c){
+    int column = schema.at(unqualified_name(insert.table_, insert.columns_[c]));
+    if( std::find(columns.begin(), columns.end(), column) != columns.end() ) throw std::runtime_error("column listed twice: " + insert.columns_[c]);
+    for(auto& row : insert.rows_){ written_column(schema, insert.table_, insert.columns_[c], row[c]); }
+    columns.push_back(column);
+  }
+
+  table_data buffer;
+  buffer.schema_ = schema;
+  {
+    table_builder builder(buffer);
+    std::vector<basic_value const*> values(schema.names_.size());
+    for(auto& row : insert.rows_){
+      std::fill(values.begin(), values.end(), nullptr);
+      for(std::size_t c = 0; c < columns.size(); ++c){ values[columns[c]] = &row[c]; }
+      for(std::size_t c = 0; c < values.size(); ++c){
+        if( values[c] ) put_value(builder, c, *values[c]);
+        else builder.put_null(c);
+      }
+      builder.end_row();
+    }
+  }
+  check_query();
+  store->write([&](table_data& table){
+    table.blocks_.insert(table.blocks_.end(), buffer.blocks_.begin(), buffer.blocks_.end());
+  });
+  written(catalog, insert.table_);
+  return insert.rows_.size();
+}
+
+//the blocks of a table holding matching rows, rebuilt in parallel with the new values
+struct updated_blocks{
+  std::vector<std::size_t> hit_;       //block indexes
+  std::vector<block_ptr> rebuilt_;
+  std::vector<std::size_t> rows_;      //rows changed per block
+};
+
+updated_blocks update_blocks(table_data const& table, std::vector<basic_value const*> const& values, bound_conditions const& conds){
+  updated_blocks out;
+  selection sel = filter_blocks(table, conds, std::numeric_limits<std::size_t>::max());
+  for(std::size_t b = 0; b < sel.size(); ++b){
+    if( sel[b].empty() ) continue;
+    out.hit_.push_back(b);
+    out.rows_.push_back(sel[b].size());
+  }
+
+  out.rebuilt_.resize(out.hit_.size());
+  run_morsels(workers_for(out.hit_.size()), out.hit_.size(), [&](unsigned, std::size_t i){
+    table_block const& block = *table.blocks_[out.hit_[i]];
+    std::vector<std::uint32_t> const& rows = sel[out.hit_[i]];
+    table_data rebuilt;
+    rebuilt.schema_ = table.schema_;
+    {
+      table_builder builder(rebuilt, block.rows_);
+      for(std::size_t r = 0, next = 0; r < block.rows_; ++r){
+        if( next == rows.size() || rows[next] != r ){
+          builder.copy_row(block, r).end_row();
+          continue;
+        }
+        ++next;
+        for(std::size_t c = 0; c < values.size(); ++c){
+          if( values[c] ) put_value(builder, c, *values[c]);
+          else builder.copy_cell(c, block, r);
+        }
+        builder.end_row();
+      }
+    }
+    out.rebuilt_[i] = rebuilt.blocks_.front();
+    return true;
+  });
+  return out;
+}
+
+/*
+The matching blocks of a snapshot are rebuilt outside the write lock: the workers yield to the
+scheduler, and an INSERT or UPDATE of the same table admitted meanwhile would otherwise wait for
+the lock holding the slot the update needs back. Under the lock the rebuilt blocks replace the
+ones still in the table; the blocks written since the snapshot (inserted, merged or rebuilt by
+another update) are updated there and then, under no token so that nothing yields with the lock
+held. A cancelled update publishes nothing.
+*/
+std::size_t execute_update(table_catalog& catalog, basic_update const& update){
+  std::shared_ptr<table_store> store = find_store(catalog, update.table_);
+  std::shared_ptr<table_data const> snapshot = store->snapshot();
+
+  std::vector<basic_value const*> values(snapshot->schema_.names_.size());
+  for(auto& a : update.assignments_){
+    values[written_column(snapshot->schema_, update.table_, a.field_, a.value_)] = &a.value_;
+  }
+  boost::optional<basic_conditions> conditions = update.conditions_;
+  if( conditions ) for(auto& cond : *conditions){ cond.field_ = unqualified_name(update.table_, cond.field_); }
+  bound_conditions conds = bind_conditions(snapshot->schema_, conditions);
+
+  updated_blocks done = update_blocks(*snapshot, values, conds);
+  check_query();
+  std::unordered_set<table_block const*> seen;
+  for(auto& block : snapshot->blocks_){ seen.insert(block.get()); }
+  std::unordered_map<table_block const*, std::size_t> replaced;
+  for(std::size_t i = 0; i < done.hit_.size(); ++i){ replaced[snapshot->blocks_[done.hit_[i]].get()] = i; }
+
+  std::size_t changed = 0;
+  store->write([&](table_data& table){
+    table_data fresh;
+    fresh.schema_ = table.schema_;
+    std::vector<std::size_t> where;
+    for(std::size_t b = 0; b < table.blocks_.size(); ++b){
+      auto it = replaced.find(table.blocks_[b].get());
+      if( it != replaced.end() ){
+        table.blocks_[b] = done.rebuilt_[it->second];
+        changed += done.rows_[it->second];
+      }else if( !seen.count(table.blocks_[b].get()) ){
+        fresh.blocks_.push_back(table.blocks_[b]);
+        where.push_back(b);
+      }
+    }
+    if( fresh.blocks_.empty() ) return;
+    query_scope none(nullptr);
+    updated_blocks late = update_blocks(fresh, values, conds);
+    for(std::size_t i = 0; i < late.hit_.size(); ++i){
+      table.blocks_[where[late.hit_[i]]] = late.rebuilt_[i];
+      changed += late.rows_[i];
+    }
+  });
+  written(catalog, update.table_);
+  return changed;
+}
+
+//demo table: users(id, age, country, name, score), every 97th score is unknown (null)
+table_data make_users(std::size_t rows){
+  static const char* countries[] = { "ro", "uk", "us", "de", "fr", "it", "es", "nl" };
+
+  table_data users;
+  users.schema_.names_ = { "id", "age", "country", "name", "score" };
+  users.schema_.kinds_ = { col_int, col_int, col_string, col_string, col_int };
+
+  std::mt19937 gen(42);
+  table_builder builder(users);
+  for(std::size_t i = 0; i < rows; ++i){
+    builder.put(0, static_cast<int>(i))
+           .put(1, static_cast<int>(18 + gen() % 73))
+           .put(2, countries[gen() % 8])
+           .put(3, "user" + std::to_string(i));
+    int score = static_cast<int>(gen() % 1000);
+    if( i % 97 == 96 ) builder.put_null(4);
+    else builder.put(4, score);
+    builder.end_row();
+  }
+  builder.finish();
+  return users;
+}
+
+//demo table: orders(id, user, amount), users place about two orders each
+table_data make_orders(std::size_t rows, std::size_t users){
+  table_data orders;
+  orders.schema_.names_ = { "id", "user", "amount" };
+  orders.schema_.kinds_ = { col_int, col_int, col_int };
+
+  std::mt19937 gen(7);
+  table_builder builder(orders);
+  for(std::size_t i = 0; i < rows; ++i){
+    builder.put(0, static_cast<int>(i))
+           .put(1, static_cast<int>(gen() % std::max<std::size_t>(users, 1)))
+           .put(2, static_cast<int>(1 + gen() % 500));
+    builder.end_row();
+  }
+  builder.finish();
+  return orders;
+}
+
+//demo table: countries(code, continent, population)
+table_data make_countries(){
+  table_data countries;
+  countries.schema_.names_ = { "code", "continent", "population" };
+  countries.schema_.kinds_ = { col_string, col_string, col_int };
+
+  table_builder builder(countries);
+  builder.put(0, "ro").put(1, "europe").put(2, 19).end_row();
+  builder.put(0, "uk").put(1, "europe").put(2, 67).end_row();
+  builder.put(0, "us").put(1, "america").put(2, 331).end_row();
+  builder.put(0, "de").put(1, "europe").put(2, 83).end_row();
+  builder.put(0, "fr").put(1, "europe").put(2, 67).end_row();
+  builder.put(0, "it").put(1, "europe").put(2, 59).end_row();
+  builder.put(0, "es").put(1, "europe").put(2, 47).end_row();
+  builder.put(0, "nl").put(1, "europe").put(2, 17).end_row();
+  builder.finish();
+  return countries;
+}
+
+//maps every dir/<table>.colf
+void open_tables(table_catalog& catalog, std::string const& dir){
+  DIR* d = ::opendir(dir.c_str());
+  if( !d ) throw std::runtime_error("can not open directory " + dir);
+  const std::string ext = ".colf";
+  while( dirent* e = ::readdir(d) ){
+    std::string file = e->d_name;
+    if( file.size() <= ext.size() || file.compare(file.size() - ext.size(), ext.size(), ext) ) continue;
+    catalog.add(boost::to_lower_copy(file.substr(0, file.size() - ext.size())), open_colfile(dir + "/" + file));
+  }
+  ::closedir(d);
+}
+
+//loads every file as the table named after it, tab separated when it ends in .tsv
+void load_csv_tables(table_catalog& catalog, std::vector<std::string> const& files){
+  for(auto& file : files){
+    std::size_t slash = file.find_last_of('/');
+    std::string name = file.substr(slash == std::string::npos ? 0 : slash + 1);
+    std::string ext = name.substr(std::min(name.find_last_of('.'), name.size()));
+    name = boost::to_lower_copy(name.substr(0, name.size() - ext.size()));
+
+    csv_options options;
+    if( boost::iequals(ext, ".tsv") ) options.delimiter_ = '\t';
+    auto start = std::chrono::steady_clock::now();
+    catalog.add(name, load_csv(file, options));
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::ifstream in(file.c_str(), std::ios::binary | std::ios::ate);
+    double mb = static_cast<double>(in.tellg()) / (1024 * 1024);
+    std::cout << "Loaded " << file << ": " << mb << " MB in " << ms << " ms (" << mb / (ms / 1000) << " MB/s)\n";
+  }
+}
+
+//the query being executed, Ctrl-C cancels it (and quits when there is none)
+std::atomic<query_token*> running_query(nullptr);
+
+extern "C" void cancel_running_query(int){
+  if( query_token* token = running_query.load() ){
+    token->cancel();
+    return;
+  }
+  std::signal(SIGINT, SIG_DFL);
+  std::raise(SIGINT);
+}
+
+//every statement runs under its own token, with a deadline when timeout is not zero
+query_token::clock::duration query_timeout = query_token::clock::duration::zero();
+
+//with --slots or --batch the statements go through the scheduler (see sql_scheduler.hpp) and the
+//report of every statement is printed in one piece once it is done
+std::unique_ptr<query_scheduler> scheduler;
+std::mutex print_mutex;
+
+//executes st under the query token of the calling thread; a select reads the tables as they were
+//when it started
+void execute_statement(table_catalog& catalog, basic_statement const& st, std::ostream& out){
+  out << "Parsing succeeded - result: " << st << "\n";
+  auto start = std::chrono::steady_clock::now();
+  try{
+    if( auto insert = boost::get<basic_insert>(&st) ){
+      std::size_t rows = execute_insert(catalog, *insert);
+      auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+      out << "Inserted " << rows << " rows in " << elapsed.count() << " ms\n\n";
+      return;
+    }
+    if( auto update = boost::get<basic_update>(&st) ){
+      std::size_t rows = execute_update(catalog, *update);
+      auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+      out << "Updated " << rows << " rows in " << elapsed.count() << " ms\n\n";
+      return;
+    }
+    database db = catalog.snapshot();
+    if( auto view = boost::get<basic_create_view>(&st) ){
+      std::size_t rows = create_view(db, *view);
+      auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+      out << "View " << view->name_ << ": " << rows << " rows, created in " << elapsed.count() << " ms\n\n";
+      return;
+    }
+    basic_select const& se = boost::get<basic_select>(st);
+    bool hit;
+    std::shared_ptr<result_set const> rs = execute_cached(db, se, hit);
+    auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+    out << *rs << "Executed in " << elapsed.count() << " ms" << (hit ? " (cached)" : "") << "\n\n";
+  }catch(query_cancelled const& e){
+    auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+    out << "Execution failed - " << e.what() << " after " << elapsed.count() << " ms\n\n";
+  }catch(std::exception const& e){
+    out << "Execution failed - " << e.what() << "\n\n";
+  }
+}
+
+void run_statement(table_catalog& catalog, basic_statement const& se, query_class cls = class_interactive){
+  if( scheduler ){
+    scheduler->submit(cls, [&catalog, se](query_token&){
+      std::ostringstream out;
+      execute_statement(catalog, se, out);
+      std::lock_guard<std::mutex> lock(print_mutex);
+      std::cout << out.str();
+    }, query_timeout);
+    return;
+  }
+
+  query_token token(query_timeout);
+  query_scope scope(&token);
+  running_query = &token;
+  execute_statement(catalog, se, std::cout);
+  running_query = nullptr;
+}
+
+std::ostream& operator<<(std::ostream& os, scheduler_stats const& s){
+  return os << s.admitted_ << " statements, wait mean " << s.mean_wait_ms() << " ms, p99 <= " << s.wait_quantile_ms(0.99)
+            << " ms, max " << s.max_wait_ms_ << " ms, peak queue " << s.peak_queued_ << ", " << s.yields_ << " yields";
+}
+
+//the statements of a script file, in one pass; a statement that does not parse is reported and
+//skipped up to its ';'
+int run_script(table_catalog& catalog, std::string const& file, query_class cls = class_interactive){
+  std::ifstream in(file.c_str(), std::ios::binary);
+  if( !in ){
+    std::cout << "can not open " << file << "\n";
+    return 1;
+  }
+  std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+  typedef std::string::const_iterator iterator;
+  basic_statement_grammar<iterator> gram;
+  script_grammar<iterator, basic_statement, sql_space_type> script(gram,
+    [&](basic_statement& se){ run_statement(catalog, se, cls); },
+    [](script_error const& e){
+      std::lock_guard<std::mutex> lock(print_mutex);
+      std::cout << "Parsing failed - line " << e.line_ << ": \" " << e.text_ << "\"\n\n";
+    });
+
+  auto start = std::chrono::steady_clock::now();
+  auto first = text.cbegin();
+  qi::phrase_parse(first, text.cend(), script, sql_space);
+  auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+  std::lock_guard<std::mutex> lock(print_mutex);
+  std::cout << "Script " << file << ": " << script.statements_ << " statements, " << script.errors_ << " errors, "
+            << elapsed.count() << " ms\n";
+  return script.errors_ ? 1 : 0;
+}
+
+//g++ file.cpp -std=c++11 -O2 -pthread
+//./a.out [rows of the demo users table, orders get twice as many]
+//./a.out --save dir [rows]    also writes the demo tables to dir/<table>.colf
+//./a.out --open dir           maps the tables of dir instead of generating them
+//./a.out --csv file...        loads csv / tsv files instead of generating the tables
+//any of them followed by --script file runs the statements of file instead of reading lines
+//and / or by --timeout ms cancels every statement running for longer than ms milliseconds
+//and / or by --slots n runs the statements through the scheduler, n of them at a time
+//and / or by --batch file runs the statements of file through the scheduler as batch statements,
+//                         while the script / the lines run as interactive statements
+//and / or by --cache-mb n keeps up to n MB of results of repeated statements (64 by default, 0 is off)
+//INSERT INTO and UPDATE change the tables in memory only, --save writes the tables as generated
+//Ctrl-C cancels the running statement (without the scheduler)
+
+int main(int argc, char* argv[]){
+  std::cout << "\n";
+
+  std::string script, batch;
+  unsigned slots = 0;
+  while( argc > 2 ){
+    std::string trailing = argv[argc - 2];
+    if( trailing == "--script" ) script = argv[argc - 1];
+    else if( trailing == "--timeout" ) query_timeout = std::chrono::milliseconds(std::stoul(argv[argc - 1]));
+    else if( trailing == "--slots" ) slots = static_cast<unsigned>(std::stoul(argv[argc - 1]));
+    else if( trailing == "--batch" ) batch = argv[argc - 1];
+    else if( trailing == "--cache-mb" ){
+      std::size_t mb = std::stoul(argv[argc - 1]);
+      cache.reset(mb ? new select_cache(mb * 1024 * 1024) : nullptr);
+    }
+    else break;
+    argc -= 2;
+  }
+  std::signal(SIGINT, cancel_running_query);
+
+  table_catalog catalog;
+  std::string option = argc > 2 ? argv[1] : "";
+  try{
+    if( option == "--open" ){
+      open_tables(catalog, argv[2]);
+    }else if( option == "--csv" ){
+      load_csv_tables(catalog, std::vector<std::string>(argv + 2, argv + argc));
+    }else{
+      int rows_arg = (option == "--save") ? 3 : 1;
+      std::size_t users = argc > rows_arg ? std::stoul(argv[rows_arg]) : 1000000;
+      catalog.add("users", make_users(users));
+      catalog.add("orders", make_orders(2 * users, users));
+      catalog.add("countries", make_countries());
+      if( option == "--save" ){
+        for(auto& t : catalog.snapshot()){ write_colfile(*t.second, std::string(argv[2]) + "/" + t.first + ".colf"); }
+      }
+    }
+  }catch(std::exception const& e){
+    std::cout << "Loading the tables failed - " << e.what() << "\n";
+    return 1;
+  }
+  for(auto& t : catalog.snapshot()){
+    std::cout << "Table " << t.first << ": " << t.second->rows() << " rows, " << t.second->bytes() / 1024 << " KB\n";
+  }
   std::cout << "\n";
 
+  if( slots || !batch.empty() ) scheduler.reset(new query_scheduler(slots ? slots : 2));
+  std::thread batch_feeder;
+  if( !batch.empty() ) batch_feeder = std::thread([&]{ run_script(catalog, batch, class_batch); });
+  auto finish = [&](int status){
+    if( batch_feeder.joinable() ) batch_feeder.join();
+    if( scheduler ){
+      scheduler->drain();
+      std::cout << "Scheduler interactive: " << scheduler->stats(class_interactive) << "\n"
+                << "Scheduler batch: " << scheduler->stats(class_batch) << "\n";
+    }
+    if( cache ) std::cout << "Result cache: " << cache->stats() << "\n";
+    return status;
+  };
+  if( !script.empty() ) return finish(run_script(catalog, script));
+
   std::string line;
   while (std::getline(std::cin, line)){
     if (line.empty()) break;
@@ -179,18 +2158,20 @@ int main( /* ... */ ){
     auto iter = line.begin();
     auto end = line.end();
 
-    ascii::space_type ws;
-    basic_select_grammar<std::string::iterator> gram;
+    sql_space_type ws;
+    basic_statement_grammar<std::string::iterator> gram;
 
-    basic_select se;
+    basic_statement se;
     if (phrase_parse(iter, end, gram, ws, se) && iter == end){
-      std::cout << "Parsing succeeded - result: " << se << "\n";
+      run_statement(catalog, se);
     }else{
       std::string rest(iter, end);
+      std::lock_guard<std::mutex> lock(print_mutex);
       std::cout << "Parsing failed - stopped at: \" " << rest << "\"\n";
     }
   }
 
+  finish(0);
   std::cout << "Bye... :-) \n";
   return 0;
 }
@@ -0,0 +1,101 @@
+//APPROX_COUNT_DISTINCT (sql_hll.hpp) against an exact count with a hash set:
+//throughput and memory for a few cardinalities over the same number of values
+
+#include "sql_hash_agg.hpp"
+#include "sql_hll.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <unordered_set>
+#include <vector>
+
+//counts the bytes the exact set allocates
+std::size_t allocated_bytes = 0;
+
+template<typename T>
+struct counting_allocator{
+  using value_type = T;
+
+  counting_allocator() = default;
+  template<typename U> counting_allocator(counting_allocator<U> const&) {}
+
+  T* allocate(std::size_t n){
+    allocated_bytes += n * sizeof(T);
+    return static_cast<T*>(::operator new(n * sizeof(T)));
+  }
+
+  void deallocate(T* p, std::size_t n){
+    allocated_bytes -= n * sizeof(T);
+    ::operator delete(p);
+  }
+};
+
+template<typename T, typename U>
+bool operator==(counting_allocator<T> const&, counting_allocator<U> const&){ return true; }
+template<typename T, typename U>
+bool operator!=(counting_allocator<T> const&, counting_allocator<U> const&){ return false; }
+
+using exact_set = std::unordered_set<int, std::hash<int>, std::equal_to<int>, counting_allocator<int>>;
+
+template<typename F>
+double time_ms(F f){
+  auto start = std::chrono::steady_clock::now();
+  f();
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+//g++ file.cpp -std=c++11 -O2
+//./a.out [values]
+
+int main(int argc, char* argv[]){
+  std::size_t n = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10000000;
+
+  std::cout << "\n" << n << " values\n\n"
+            << std::setw(12) << "distinct"
+            << std::setw(14) << "hll ms" << std::setw(12) << "hll MB/s" << std::setw(12) << "hll bytes" << std::setw(12) << "hll error"
+            << std::setw(14) << "exact ms" << std::setw(12) << "exact MB/s" << std::setw(14) << "exact bytes" << "\n";
+
+  for(std::size_t distinct : { 1000ul, 100000ul, 1000000ul, 10000000ul }){
+    std::mt19937 gen(42);
+    std::vector<int> values(n);
+    for(auto& v : values){ v = static_cast<int>(gen() % distinct); }
+    std::size_t truth = std::unordered_set<int>(values.begin(), values.end()).size();
+
+    hll_sketch sketch;
+    double hll_ms = time_ms([&]{
+      const std::size_t batch = 1024;
+      std::uint64_t hashes[batch];
+      for(std::size_t start = 0; start < n; start += batch){
+        std::size_t len = std::min(batch, n - start);
+        for(std::size_t i = 0; i < len; ++i){ hashes[i] = hash_int(static_cast<std::uint32_t>(values[start + i])); }
+        sketch.add_hashes(hashes, len);
+      }
+    });
+    double estimate = sketch.estimate();
+
+    std::size_t exact_bytes = 0, exact_count = 0;
+    double exact_ms = time_ms([&]{
+      exact_set set;
+      for(auto v : values){ set.insert(v); }
+      exact_count = set.size();
+      exact_bytes = allocated_bytes;
+    });
+
+    double mb = n * sizeof(int) / 1e6;
+    std::cout << std::setw(12) << exact_count
+              << std::setw(14) << std::fixed << std::setprecision(1) << hll_ms
+              << std::setw(12) << mb / (hll_ms / 1000)
+              << std::setw(12) << sketch.bytes()
+              << std::setw(11) << std::setprecision(2) << 100.0 * std::fabs(estimate - truth) / truth << "%"
+              << std::setw(14) << std::setprecision(1) << exact_ms
+              << std::setw(12) << mb / (exact_ms / 1000)
+              << std::setw(14) << exact_bytes << "\n";
+  }
+
+  std::cout << "\nBye... :-) \n";
+  return 0;
+}
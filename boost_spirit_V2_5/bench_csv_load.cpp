@@ -0,0 +1,119 @@
+//csv loading (sql_csv.hpp) against a getline + stringstream loader over the same generated text,
+//both filling the same columnar table
+
+#include "sql_csv.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+
+//users(id, age, name, score, note): every 50th note is quoted, with a delimiter and doubled quotes
+std::string make_csv(std::size_t rows){
+  std::mt19937 gen(42);
+  std::string text = "id,age,name,score,note\n";
+  for(std::size_t i = 0; i < rows; ++i){
+    text += std::to_string(i) + "," + std::to_string(18 + gen() % 73) + ",user" + std::to_string(i) + ","
+          + std::to_string(static_cast<int>(gen() % 2000000) - 1000000) + ",";
+    text += (i % 50 == 0) ? "\"a, \"\"quoted\"\" note\"" : "plain note";
+    text += "\n";
+  }
+  return text;
+}
+
+//the straightforward loader: no quotes, so the quoted notes come out cut at their delimiter
+table_data naive_load(std::string const& text){
+  table_data table;
+  table.schema_.names_ = { "id", "age", "name", "score", "note" };
+  table.schema_.kinds_ = { col_int, col_int, col_string, col_int, col_string };
+  table_builder builder(table);
+  std::istringstream in(text);
+  std::string line, field;
+  std::getline(in, line);
+  while( std::getline(in, line) ){
+    std::istringstream fields(line);
+    for(std::size_t c = 0; c < 5 && std::getline(fields, field, ','); ++c){
+      if( table.schema_.kinds_[c] == col_int ) builder.put(c, std::atoi(field.c_str()));
+      else builder.put(c, field);
+    }
+    builder.end_row();
+  }
+  builder.finish();
+  return table;
+}
+
+long long sum_column(table_data const& table, int c){
+  long long sum = 0;
+  for(auto& block : table.blocks_){
+    for(std::size_t r = 0; r < block->rows_; ++r){ sum += block->columns_[c].ints_[r]; }
+  }
+  return sum;
+}
+
+//small inputs with known results: rows and nulls in the last column
+struct csv_case{
+  const char* name_;
+  std::string text_;
+  std::size_t rows_;
+  std::size_t last_nulls_;
+};
+
+void check_cases(){
+  std::string late = "a,b\n";
+  for(int i = 0; i < 1500; ++i){ late += std::to_string(i) + "," + std::to_string(i) + "\n"; }
+  late += "1500,n/a\n";
+
+  std::vector<csv_case> cases = {
+    { "last field empty, no newline at the end", "a,b,c\n1,2,x\n3,4,", 2, 1 },
+    { "last field empty, newline at the end", "a,b,c\n1,2,x\n3,4,\n", 2, 1 },
+    { "no newline at the end", "a,b,c\n1,2,x\n3,4,y", 2, 0 },
+    { "crlf, quotes, empty last fields", "a,b\r\n\"x,y\",1\r\n\"q\"\"z\",\r\n,", 3, 2 },
+    { "no int past the sample rows", late, 1501, 0 },
+    { "one column, an empty line", "a\n1\n\n3\n", 3, 1 },
+    { "one column, crlf, an empty line", "a\r\n1\r\n\r\n3", 3, 1 },
+  };
+  for(auto& c : cases){
+    table_data t = parse_csv(c.text_.data(), c.text_.size());
+    std::size_t nulls = 0;
+    for(auto& block : t.blocks_){ nulls += block->columns_.back().null_count_; }
+    bool ok = t.rows() == c.rows_ && nulls == c.last_nulls_;
+    std::cout << std::left << std::setw(44) << c.name_ << std::right << std::setw(6) << t.rows() << " rows" << std::setw(6) << nulls << " nulls"
+              << (ok ? "  ok" : "  WRONG") << "\n";
+  }
+}
+
+template<typename F>
+double time_ms(F f){
+  auto start = std::chrono::steady_clock::now();
+  f();
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+//g++ file.cpp -std=c++11 -O2 -pthread
+//./a.out [rows]
+
+int main(int argc, char* argv[]){
+  std::size_t rows = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 5000000;
+  std::string text = make_csv(rows);
+  double mb = text.size() / (1024.0 * 1024.0);
+
+  table_data fast, naive;
+  double fast_ms = time_ms([&]{ fast = parse_csv(text.data(), text.size()); });
+  double naive_ms = time_ms([&]{ naive = naive_load(text); });
+
+  std::cout << "\n" << rows << " rows, " << std::fixed << std::setprecision(1) << mb << " MB, " << worker_count() << " workers\n\n"
+            << std::setw(10) << "loader" << std::setw(12) << "rows" << std::setw(12) << "ms" << std::setw(12) << "MB/s" << std::setw(20) << "sum(score)" << "\n"
+            << std::setw(10) << "simd" << std::setw(12) << fast.rows() << std::setw(12) << fast_ms << std::setw(12) << mb / (fast_ms / 1000)
+            << std::setw(20) << sum_column(fast, 3) << "\n"
+            << std::setw(10) << "naive" << std::setw(12) << naive.rows() << std::setw(12) << naive_ms << std::setw(12) << mb / (naive_ms / 1000)
+            << std::setw(20) << sum_column(naive, 3) << "\n";
+
+  std::cout << "\n";
+  check_cases();
+
+  std::cout << "\nBye... :-) \n";
+  return 0;
+}
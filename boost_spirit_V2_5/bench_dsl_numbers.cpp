@@ -0,0 +1,176 @@
+//number_ (qi_fast_real.hpp) against double_ | int_ as the value of numeric heavy set statements,
+//like the ones of very_small_sql_like_dsl.cpp:  set a0 = 12, a1 = -3.25, a2 = 6.02e23, ...
+
+#include "qi_fast_real.hpp"
+
+#include <boost/fusion/include/std_pair.hpp>
+#include <boost/spirit/include/qi.hpp>
+#include <boost/variant.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace qi = boost::spirit::qi;
+namespace ascii = boost::spirit::ascii;
+
+using value = boost::variant<double, int, std::string>;
+using assignment = std::pair<std::string, value>;
+
+//set_ of the dsl with the value parser chosen by Fast
+template<typename Iterator, bool Fast>
+struct set_grammar : qi::grammar<Iterator, std::vector<assignment>(), ascii::space_type>{
+  set_grammar() : set_grammar::base_type(set_){
+    using namespace qi;
+    strlit_ = "'" >> *( (lit('\\') >> char_) | ~char_("'") ) > "'";
+    property_ = alpha >> *alnum;
+    if( Fast ) value_ = number_ | strlit_;
+    else value_ = double_ | int_ | strlit_;
+    set_ = no_case["set"] >> (property_ >> '=' >> value_) % ',';
+    values_ = value_ % ',';
+  }
+
+  qi::rule<Iterator, std::string()> strlit_;
+  qi::rule<Iterator, std::string()> property_;
+  qi::rule<Iterator, value(), ascii::space_type> value_;
+  qi::rule<Iterator, std::vector<assignment>(), ascii::space_type> set_;
+  qi::rule<Iterator, std::vector<value>(), ascii::space_type> values_;
+};
+
+//statements of 20 assignments: mostly ints, some decimals and exponents, now and then a string
+std::vector<std::string> make_statements(std::size_t count){
+  std::mt19937 gen(42);
+  std::vector<std::string> statements;
+  for(std::size_t s = 0; s < count; ++s){
+    std::string text = "set ";
+    for(int a = 0; a < 20; ++a){
+      if( a ) text += ", ";
+      text += "a" + std::to_string(a) + " = ";
+      unsigned kind = gen() % 10;
+      if( kind < 6 ) text += std::to_string(static_cast<int>(gen() % 2000000) - 1000000);
+      else if( kind < 8 ) text += std::to_string(gen() % 100000) + "." + std::to_string(gen() % 1000);
+      else if( kind < 9 ) text += std::to_string(gen() % 1000) + "." + std::to_string(gen() % 100) + "e" + std::to_string(static_cast<int>(gen() % 40) - 20);
+      else text += "'text'";
+    }
+    statements.push_back(text);
+  }
+  return statements;
+}
+
+//results keep their room from the previous run, so mostly the parsing is timed
+template<bool Fast>
+double parse_all(std::vector<std::string> const& statements, std::vector<std::vector<assignment>>& results){
+  set_grammar<std::string::const_iterator, Fast> grammar;
+  results.resize(statements.size());
+  auto start = std::chrono::steady_clock::now();
+  for(std::size_t i = 0; i < statements.size(); ++i){
+    results[i].clear();
+    auto first = statements[i].cbegin();
+    if( !qi::phrase_parse(first, statements[i].cend(), grammar, ascii::space, results[i]) || first != statements[i].cend() )
+      std::cout << "failed: " << statements[i] << "\n";
+  }
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+//the values of all the statements as one list, without the names and the statements around them
+template<bool Fast>
+double parse_values(std::string const& text, std::vector<value>& values){
+  set_grammar<std::string::const_iterator, Fast> grammar;
+  values.clear();
+  auto start = std::chrono::steady_clock::now();
+  auto first = text.cbegin();
+  if( !qi::phrase_parse(first, text.cend(), grammar.values_, ascii::space, values) || first != text.cend() ) std::cout << "failed\n";
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+//same numbers, whatever their type
+struct as_double : boost::static_visitor<double>{
+  double operator()(double d) const { return d; }
+  double operator()(int i) const { return i; }
+  double operator()(std::string const&) const { return 0; }
+};
+
+//a literal parses the same whatever follows it: alone, the SSE path of parse_real does not run
+//(less than 16 bytes), followed by more text it does
+void check_padding(){
+  std::vector<std::string> literals = { "123e", "7E", "-42e+", "0e-", "12.5e", "3.e", "123", "-8.25", "6.02e23", "1e5x", "99999999e" };
+  std::string padding = ", a1 = 12345678901234567890";
+  std::size_t wrong = 0;
+  for(auto& text : literals){
+    std::string padded = text + padding;
+    real_literal alone, followed;
+    std::size_t n = parse_real(text.data(), text.size(), alone), m = parse_real(padded.data(), padded.size(), followed);
+    bool same = n == m && alone.integral_ == followed.integral_ && (!alone.integral_ || alone.int_ == followed.int_) && alone.double_ == followed.double_;
+    if( !same ){
+      ++wrong;
+      std::cout << "different when followed by text: " << text << "\n";
+    }
+  }
+  std::cout << "literals alone and followed by text: " << literals.size() - wrong << " of " << literals.size() << " the same\n";
+}
+
+//g++ file.cpp -std=c++11 -O2
+//./a.out [statements]
+
+int main(int argc, char* argv[]){
+  std::size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+  std::vector<std::string> statements = make_statements(count);
+  std::size_t bytes = 0;
+  for(auto& s : statements){ bytes += s.size(); }
+  double mb = bytes / (1024.0 * 1024.0);
+
+  //best of 5, the two taking turns
+  std::vector<std::vector<assignment>> slow, fast;
+  double slow_ms = 0, fast_ms = 0;
+  for(int k = 0; k < 5; ++k){
+    double ms = parse_all<false>(statements, slow);
+    if( k == 0 || ms < slow_ms ) slow_ms = ms;
+    ms = parse_all<true>(statements, fast);
+    if( k == 0 || ms < fast_ms ) fast_ms = ms;
+  }
+
+  std::string list;
+  for(auto& s : statements){
+    for(std::size_t at = s.find('='); at != std::string::npos; at = s.find('=', at + 1)){
+      if( !list.empty() ) list += ", ";
+      list += s.substr(at + 2, s.find(',', at) == std::string::npos ? std::string::npos : s.find(',', at) - at - 2);
+    }
+  }
+  std::vector<value> slow_values, fast_values;
+  double slow_values_ms = 0, fast_values_ms = 0;
+  for(int k = 0; k < 5; ++k){
+    double ms = parse_values<false>(list, slow_values);
+    if( k == 0 || ms < slow_values_ms ) slow_values_ms = ms;
+    ms = parse_values<true>(list, fast_values);
+    if( k == 0 || ms < fast_values_ms ) fast_values_ms = ms;
+  }
+  double list_mb = list.size() / (1024.0 * 1024.0);
+
+  std::size_t ints = 0, mismatches = 0;
+  for(std::size_t s = 0; s < count; ++s){
+    for(std::size_t a = 0; a < fast[s].size(); ++a){
+      ints += fast[s][a].second.which() == 1;
+      if( boost::apply_visitor(as_double(), fast[s][a].second) != boost::apply_visitor(as_double(), slow[s][a].second) ) ++mismatches;
+    }
+  }
+
+  std::cout << "\n" << count << " set statements, " << std::fixed << std::setprecision(1) << mb << " MB\n\n"
+            << std::setw(20) << "value parser" << std::setw(12) << "ms" << std::setw(12) << "MB/s"
+            << std::setw(16) << "values only ms" << std::setw(12) << "MB/s" << "\n"
+            << std::setw(20) << "double_ | int_" << std::setw(12) << slow_ms << std::setw(12) << mb / (slow_ms / 1000)
+            << std::setw(16) << slow_values_ms << std::setw(12) << list_mb / (slow_values_ms / 1000) << "\n"
+            << std::setw(20) << "number_" << std::setw(12) << fast_ms << std::setw(12) << mb / (fast_ms / 1000)
+            << std::setw(16) << fast_values_ms << std::setw(12) << list_mb / (fast_values_ms / 1000) << "\n"
+            << "\nints: " << ints << " (double_ | int_ gives none), value mismatches: " << mismatches << "\n";
+
+  std::cout << "\n";
+  check_padding();
+
+  std::cout << "\nBye... :-) \n";
+  return 0;
+}
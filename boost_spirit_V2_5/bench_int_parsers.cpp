@@ -0,0 +1,107 @@
+//swar_int_ / swar_uint_ (qi_swar_int.hpp) against qi::int_ / qi::uint_ on number dense text:
+//comma separated lists of 1..10 digit numbers, parsed without and with a space skipper
+
+#include "qi_swar_int.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace qi = boost::spirit::qi;
+namespace ascii = boost::spirit::ascii;
+
+//count numbers of max_digits digits at most, signed ones with a '-' now and then
+std::string make_numbers(std::size_t count, unsigned max_digits, bool sign, char const* separator){
+  std::mt19937 gen(42);
+  std::string text;
+  for(std::size_t i = 0; i < count; ++i){
+    unsigned digits = 1 + gen() % max_digits;
+    unsigned long long v = gen() % 9 + 1;
+    for(unsigned d = 1; d < digits; ++d){ v = v * 10 + gen() % 10; }
+    if( v > 2147483647ull ) v %= 2147483647ull;
+    if( i ) text += separator;
+    if( sign && gen() % 4 == 0 ) text += '-';
+    text += std::to_string(v);
+  }
+  return text;
+}
+
+//the whole text, with a skipper or (unused) without one
+template<typename Parser, typename Skipper, typename Attribute>
+bool parse_all(std::string const& text, Parser const& p, Skipper const& skipper, Attribute& attr){
+  auto first = text.begin();
+  return qi::phrase_parse(first, text.end(), p, skipper, attr) && first == text.end();
+}
+template<typename Parser, typename Attribute>
+bool parse_all(std::string const& text, Parser const& p, boost::spirit::unused_type, Attribute& attr){
+  auto first = text.begin();
+  return qi::parse(first, text.end(), p, attr) && first == text.end();
+}
+
+template<typename F>
+double time_ms(F f){
+  auto start = std::chrono::steady_clock::now();
+  f();
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+//best of 5 parses into a vector with room for all the values
+template<typename T, typename Parser, typename Skipper>
+double best_ms(std::string const& text, std::size_t count, Parser const& p, Skipper const& skipper, std::vector<T>& values, bool& ok){
+  double best = 0;
+  for(int k = 0; k < 5; ++k){
+    values.clear();
+    values.reserve(count);
+    double ms = time_ms([&]{ ok = parse_all(text, p, skipper, values); });
+    if( k == 0 || ms < best ) best = ms;
+  }
+  return best;
+}
+
+//parses text with list_qi and list_swar, checks that both give the same values, prints the throughput
+template<typename T, typename QiList, typename SwarList, typename Skipper>
+void run(char const* name, std::string const& text, std::size_t count, QiList const& list_qi, SwarList const& list_swar, Skipper const& skipper){
+  std::vector<T> qi_values, swar_values;
+  bool qi_ok = false, swar_ok = false;
+  double qi_ms = best_ms(text, count, list_qi, skipper, qi_values, qi_ok);
+  double swar_ms = best_ms(text, count, list_swar, skipper, swar_values, swar_ok);
+  double mb = text.size() / (1024.0 * 1024.0);
+  std::cout << std::setw(24) << name << std::setw(12) << qi_values.size()
+            << std::setw(12) << mb / (qi_ms / 1000) << std::setw(12) << mb / (swar_ms / 1000)
+            << std::setw(10) << qi_ms / swar_ms << "x"
+            << ((qi_ok && swar_ok && qi_values == swar_values) ? "" : "   MISMATCH") << "\n";
+}
+
+//g++ file.cpp -std=c++11 -O2
+//./a.out [numbers]
+
+int main(int argc, char* argv[]){
+  std::size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 5000000;
+  qi::int_type int_;
+  qi::uint_type uint_;
+  boost::spirit::unused_type none;
+
+  std::cout << "\n" << count << " numbers per input\n\n" << std::fixed << std::setprecision(1)
+            << std::setw(24) << "input" << std::setw(12) << "numbers" << std::setw(12) << "qi MB/s" << std::setw(12) << "swar MB/s"
+            << std::setw(11) << "speedup" << "\n";
+
+  for(unsigned digits : {3u, 6u, 10u}){
+    std::string text = make_numbers(count, digits, false, ",");
+    std::string label = "uint_ 1.." + std::to_string(digits) + " digits";
+    run<unsigned>(label.c_str(), text, count, uint_ % ',', swar_uint_ % ',', none);
+  }
+  for(unsigned digits : {3u, 6u, 10u}){
+    std::string text = make_numbers(count, digits, true, ",");
+    std::string label = "int_ 1.." + std::to_string(digits) + " digits";
+    run<int>(label.c_str(), text, count, int_ % ',', swar_int_ % ',', none);
+  }
+  std::string spaced = make_numbers(count, 10, true, " , ");
+  run<int>("int_ 1..10, skipper", spaced, count, int_ % ',', swar_int_ % ',', ascii::space);
+
+  std::cout << "\nBye... :-) \n";
+  return 0;
+}
@@ -0,0 +1,223 @@
+//the filter path of the executor against a naive interpreter switching on the operator and visiting
+//the literal's variant for every row, on multi-condition filters over the same table: the int
+//comparisons run on the compressed columns into a bitmap and the compiled predicates
+//(sql_predicate.hpp) narrow the surviving rows, as select_batch of basic_sql_select2.cpp does
+
+#include "sql_predicate.hpp"
+
+#include <boost/variant.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+//users(age, country, name, score): every 97th score is null, country is dictionary sized (8 values),
+//name is not (offsets + heap)
+table_data make_table(std::size_t rows){
+  static const char* countries[] = { "ro", "uk", "us", "de", "fr", "it", "es", "nl" };
+
+  table_data t;
+  t.schema_.names_ = { "age", "country", "name", "score" };
+  t.schema_.kinds_ = { col_int, col_string, col_string, col_int };
+  std::mt19937 gen(42);
+  table_builder builder(t);
+  for(std::size_t i = 0; i < rows; ++i){
+    builder.put(0, static_cast<int>(18 + gen() % 73))
+           .put(1, countries[gen() % 8])
+           .put(2, "user" + std::to_string(gen() % 1000000));
+    if( i % 97 == 96 ) builder.put_null(3);
+    else builder.put(3, static_cast<int>(gen() % 1000));
+    builder.end_row();
+  }
+  builder.finish();
+  return t;
+}
+
+//the naive side: one condition as parsed, evaluated row by row
+struct null{};
+using literal = boost::variant<null, int, std::string>;
+
+struct condition{
+  int column_;
+  compare_op op_;
+  literal value_;
+  literal high_;
+};
+
+struct interpret : boost::static_visitor<bool>{
+  interpret(condition const& cond, column_chunk const& col, std::size_t row) : cond_(cond), col_(col), row_(row) {}
+
+  bool operator()(null) const { return (cond_.op_ == cmp_eq) == col_.null_at(row_); }
+
+  bool operator()(int v) const {
+    if( col_.null_at(row_) ) return false;
+    int x = col_.ints_[row_];
+    switch( cond_.op_ ){
+      case cmp_eq: return x == v;
+      case cmp_neq: return x != v;
+      case cmp_lt: return x < v;
+      case cmp_le: return x <= v;
+      case cmp_gt: return x > v;
+      case cmp_ge: return x >= v;
+      default: return x >= v && x <= boost::get<int>(cond_.high_);
+    }
+  }
+
+  bool operator()(std::string const& v) const {
+    if( col_.null_at(row_) ) return false;
+    int c = col_.strings_.get(row_).compare(boost::string_ref(v));
+    switch( cond_.op_ ){
+      case cmp_eq: return c == 0;
+      case cmp_neq: return c != 0;
+      case cmp_lt: return c < 0;
+      case cmp_le: return c <= 0;
+      case cmp_gt: return c > 0;
+      case cmp_ge: return c >= 0;
+      default: return c >= 0 && col_.strings_.get(row_).compare(boost::string_ref(boost::get<std::string>(cond_.high_))) <= 0;
+    }
+  }
+
+  condition const& cond_;
+  column_chunk const& col_;
+  std::size_t row_;
+};
+
+std::size_t count_naive(table_data const& t, std::vector<condition> const& conds){
+  std::size_t n = 0;
+  for(auto& b : t.blocks_){
+    for(std::size_t r = 0; r < b->rows_; ++r){
+      bool pass = true;
+      for(auto& cond : conds){
+        if( !boost::apply_visitor(interpret(cond, b->columns_[cond.column_], r), cond.value_) ){
+          pass = false;
+          break;
+        }
+      }
+      n += pass;
+    }
+  }
+  return n;
+}
+
+//an int comparison as the interval of the passing values, != for the values outside of it
+struct int_test{
+  int column_;
+  int lo_;
+  int hi_;
+  bool negate_;
+};
+
+struct compiled{
+  std::vector<int_test> ints_;
+  row_filter_ptr rest_;
+};
+
+compiled compile(std::vector<condition> const& conds){
+  compiled out;
+  std::vector<row_filter_ptr> rest;
+  for(auto& cond : conds){
+    if( boost::get<null>(&cond.value_) ) rest.push_back(compile_null_test(cond.column_, cond.op_ == cmp_eq));
+    else if( std::string const* s = boost::get<std::string>(&cond.value_) ){
+      rest.push_back(compile_string_compare(cond.column_, cond.op_, *s, cond.op_ == cmp_between ? boost::get<std::string>(cond.high_) : ""));
+    }else{
+      int v = boost::get<int>(cond.value_), lo = v, hi = v;
+      if( cond.op_ == cmp_lt ) lo = std::numeric_limits<int>::min(), hi = v - 1;
+      if( cond.op_ == cmp_le ) lo = std::numeric_limits<int>::min();
+      if( cond.op_ == cmp_gt ) lo = v + 1, hi = std::numeric_limits<int>::max();
+      if( cond.op_ == cmp_ge ) hi = std::numeric_limits<int>::max();
+      if( cond.op_ == cmp_between ) hi = boost::get<int>(cond.high_);
+      out.ints_.push_back(int_test{cond.column_, lo, hi, cond.op_ == cmp_neq});
+    }
+  }
+  out.rest_ = compile_and(std::move(rest));
+  return out;
+}
+
+const std::size_t batch_rows = 1024;
+
+std::size_t count_compiled(table_data const& t, compiled const& filter){
+  std::size_t n = 0;
+  std::vector<std::uint32_t> rows;
+  std::uint64_t mask[batch_rows / 64], bits[batch_rows / 64];
+  for(auto& b : t.blocks_){
+    for(std::size_t from = 0; from < b->rows_; from += batch_rows){
+      std::size_t count = std::min(batch_rows, b->rows_ - from), words = (count + 63) / 64;
+      std::fill(mask, mask + words, ~std::uint64_t(0));
+      if( count & 63 ) mask[words - 1] = (std::uint64_t(1) << (count & 63)) - 1;
+      for(auto& test : filter.ints_){
+        column_chunk const& col = b->columns_[test.column_];
+        col.ints_.match(test.lo_, test.hi_, from, count, bits);
+        for(std::size_t w = 0; w < words; ++w){
+          std::uint64_t valid = col.validity_.empty() ? ~std::uint64_t(0) : col.validity_[from / 64 + w];
+          mask[w] &= (test.negate_ ? ~bits[w] : bits[w]) & valid;
+        }
+      }
+      rows.clear();
+      for(std::size_t w = 0; w < words; ++w){
+        for(std::uint64_t m = mask[w]; m; m &= m - 1){ rows.push_back(static_cast<std::uint32_t>(from + w * 64 + __builtin_ctzll(m))); }
+      }
+      if( filter.rest_ ) filter.rest_->filter(*b, rows, 0);
+      n += rows.size();
+    }
+  }
+  return n;
+}
+
+template<typename F>
+double time_ms(F f){
+  auto start = std::chrono::steady_clock::now();
+  f();
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+//g++ file.cpp -std=c++11 -O2
+//./a.out [rows]
+
+int main(int argc, char* argv[]){
+  std::size_t n = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 4000000;
+  table_data t = make_table(n);
+
+  struct filter_case{
+    const char* text_;
+    std::vector<condition> conds_;
+  };
+  std::vector<filter_case> cases = {
+    { "age >= 30 AND age < 60 AND country == 'ro'",
+      { {0, cmp_ge, 30, null()}, {0, cmp_lt, 60, null()}, {1, cmp_eq, std::string("ro"), null()} } },
+    { "country == 'ro' AND age >= 30 AND age < 60",
+      { {1, cmp_eq, std::string("ro"), null()}, {0, cmp_ge, 30, null()}, {0, cmp_lt, 60, null()} } },
+    { "score != null AND score > 500 AND name < 'user5'",
+      { {3, cmp_neq, null(), null()}, {3, cmp_gt, 500, null()}, {2, cmp_lt, std::string("user5"), null()} } },
+    { "name == 'user4242'",
+      { {2, cmp_eq, std::string("user4242"), null()} } },
+    { "name != 'user4242' AND age > 80",
+      { {2, cmp_neq, std::string("user4242"), null()}, {0, cmp_gt, 80, null()} } },
+    { "country BETWEEN 'de' AND 'it' AND age != 40 AND score <= 100",
+      { {1, cmp_between, std::string("de"), std::string("it")}, {0, cmp_neq, 40, null()}, {3, cmp_le, 100, null()} } },
+  };
+
+  std::cout << "\n" << n << " rows\n\n"
+            << std::left << std::setw(64) << "filter" << std::right
+            << std::setw(10) << "rows" << std::setw(14) << "naive ms" << std::setw(14) << "compiled ms" << std::setw(10) << "speedup" << "\n";
+  for(auto& c : cases){
+    std::size_t naive_rows = 0, compiled_rows = 0;
+    double naive_ms = time_ms([&]{ naive_rows = count_naive(t, c.conds_); });
+    compiled filter = compile(c.conds_);
+    double compiled_ms = time_ms([&]{ compiled_rows = count_compiled(t, filter); });
+    std::cout << std::left << std::setw(64) << c.text_ << std::right
+              << std::setw(10) << compiled_rows
+              << std::setw(14) << std::fixed << std::setprecision(1) << naive_ms
+              << std::setw(14) << compiled_ms
+              << std::setw(9) << std::setprecision(2) << naive_ms / compiled_ms << "x"
+              << (naive_rows != compiled_rows ? "  MISMATCH" : "") << "\n";
+  }
+
+  std::cout << "\nBye... :-) \n";
+  return 0;
+}
@@ -0,0 +1,140 @@
+//fast_space / sql_space (qi_skipper.hpp) against ascii::space as the skipper of a select grammar,
+//over formatted sql (a clause per line, indented) and over the same statements a line each
+
+#include "qi_skipper.hpp"
+#include "qi_swar_int.hpp"
+
+#include <boost/fusion/adapted.hpp>
+#include <boost/spirit/include/qi.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace qi = boost::spirit::qi;
+namespace ascii = boost::spirit::ascii;
+
+struct condition{
+  std::string field_;
+  std::string op_;
+  int value_;
+};
+
+struct statement{
+  std::vector<std::string> columns_;
+  std::string table_;
+  std::vector<condition> conditions_;
+  std::vector<std::string> orders_;
+  unsigned limit_;
+};
+
+BOOST_FUSION_ADAPT_STRUCT( condition, (std::string, field_) (std::string, op_) (int, value_) )
+BOOST_FUSION_ADAPT_STRUCT( statement, (std::vector<std::string>, columns_) (std::string, table_)
+                           (std::vector<condition>, conditions_) (std::vector<std::string>, orders_) (unsigned, limit_) )
+
+//the clauses of basic_select_grammar (basic_sql_select2.cpp) that the statements use
+template<typename Iterator, typename Skipper>
+struct select_grammar : qi::grammar<Iterator, std::vector<statement>(), Skipper>{
+  select_grammar() : select_grammar::base_type(script_){
+    using namespace qi;
+    name_ = lexeme [ alpha >> *alnum ];
+    condition_ = name_ >> lexeme [ string("==") | string("!=") ] >> swar_int_;
+    statement_ = no_case["select"] >> (name_ % ',')
+              >> no_case["from"] >> name_
+              >> -(no_case["where"] >> (condition_ % no_case["and"]))
+              >> -(no_case["order"] >> no_case["by"] >> (name_ % ','))
+              >> (no_case["limit"] >> swar_uint_ | attr(0u)) >> ';';
+    script_ = +statement_;
+  }
+
+  qi::rule<Iterator, std::string(), Skipper> name_;
+  qi::rule<Iterator, condition(), Skipper> condition_;
+  qi::rule<Iterator, statement(), Skipper> statement_;
+  qi::rule<Iterator, std::vector<statement>(), Skipper> script_;
+};
+
+//count statements; indent > 0: a clause per line, the items on their own lines indented by indent
+//spaces, like generated sql; indent 0: a statement per line
+std::string make_script(std::size_t count, unsigned indent_by, bool comments){
+  std::mt19937 gen(42);
+  char const* columns[] = { "id", "name", "age", "score", "city", "created" };
+  std::string nl = indent_by ? "\n" : " ", indent = indent_by ? "\n" + std::string(indent_by, ' ') : " ";
+  std::string text;
+  for(std::size_t s = 0; s < count; ++s){
+    if( comments ) text += "-- statement " + std::to_string(s) + "\n";
+    text += "SELECT";
+    unsigned n = 2 + gen() % 4;
+    for(unsigned c = 0; c < n; ++c){ text += (c ? "," : "") + indent + columns[gen() % 6]; }
+    text += nl + "FROM" + indent + "users";
+    if( comments ) text += "  /* the only table */";
+    text += nl + "WHERE";
+    unsigned conditions = 1 + gen() % 3;
+    for(unsigned c = 0; c < conditions; ++c){
+      text += (c ? indent + "AND " : indent) + columns[gen() % 6] + (gen() % 2 ? " == " : " != ") + std::to_string(gen() % 100000);
+    }
+    text += nl + "ORDER BY" + indent + columns[gen() % 6] + nl + "LIMIT " + std::to_string(gen() % 1000) + ";" + (indent_by ? "\n\n" : "\n");
+  }
+  return text;
+}
+
+//best of 25 parses of the whole script, in ms; statements is the number parsed
+template<typename Skipper, typename SkipperObject>
+double parse_ms(std::string const& text, SkipperObject const& skipper, std::size_t& statements){
+  select_grammar<std::string::const_iterator, Skipper> grammar;
+  double best = 0;
+  for(int k = 0; k < 25; ++k){
+    std::vector<statement> result;
+    auto start = std::chrono::steady_clock::now();
+    auto first = text.cbegin();
+    bool ok = qi::phrase_parse(first, text.cend(), grammar, skipper, result) && first == text.cend();
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    statements = ok ? result.size() : 0;
+    if( k == 0 || ms < best ) best = ms;
+  }
+  return best;
+}
+
+void report(char const* input, char const* skipper, std::string const& text, double ms, std::size_t statements){
+  double mb = text.size() / (1024.0 * 1024.0);
+  std::cout << std::setw(22) << input << std::setw(14) << skipper << std::setw(12) << statements
+            << std::setw(12) << ms << std::setw(12) << mb / (ms / 1000) << "\n";
+}
+
+//g++ file.cpp -std=c++11 -O2
+//./a.out [statements]
+
+int main(int argc, char* argv[]){
+  std::size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 20000;
+  std::string formatted = make_script(count, 8, false);
+  std::string commented = make_script(count, 8, true);
+  std::string aligned = make_script(count, 40, false);
+  std::string one_line = make_script(count, 0, false);
+
+  std::cout << "\n" << count << " statements\n\n" << std::fixed << std::setprecision(1)
+            << std::setw(22) << "input" << std::setw(14) << "skipper" << std::setw(12) << "statements"
+            << std::setw(12) << "ms" << std::setw(12) << "MB/s" << "\n";
+  std::size_t n;
+  double ms = parse_ms<ascii::space_type>(formatted, ascii::space, n);
+  report("formatted", "ascii::space", formatted, ms, n);
+  ms = parse_ms<fast_space_type>(formatted, fast_space, n);
+  report("formatted", "fast_space", formatted, ms, n);
+  ms = parse_ms<sql_space_type>(formatted, sql_space, n);
+  report("formatted", "sql_space", formatted, ms, n);
+  ms = parse_ms<sql_space_type>(commented, sql_space, n);
+  report("formatted + comments", "sql_space", commented, ms, n);
+  ms = parse_ms<ascii::space_type>(aligned, ascii::space, n);
+  report("indented by 40", "ascii::space", aligned, ms, n);
+  ms = parse_ms<fast_space_type>(aligned, fast_space, n);
+  report("indented by 40", "fast_space", aligned, ms, n);
+  ms = parse_ms<ascii::space_type>(one_line, ascii::space, n);
+  report("one line", "ascii::space", one_line, ms, n);
+  ms = parse_ms<fast_space_type>(one_line, fast_space, n);
+  report("one line", "fast_space", one_line, ms, n);
+
+  std::cout << "\nBye... :-) \n";
+  return 0;
+}
@@ -0,0 +1,126 @@
+//queries checked and compiled at compile time (sql_static.hpp) against the same filters written by
+//hand as loops over the struct members: the two should run the same code
+
+#include "sql_static.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+struct user{
+  int id;
+  int age;
+  std::string country;
+  std::string name;
+  int score;
+};
+
+BOOST_FUSION_ADAPT_STRUCT(
+  user,
+  (int, id)
+  (int, age)
+  (std::string, country)
+  (std::string, name)
+  (int, score)
+)
+
+constexpr char by_age_and_country[] = "SELECT id, name FROM users WHERE age >= 30 AND age < 60 AND country == 'ro';";
+constexpr char by_name_range[] = "select id from users where name between 'user2' and 'user4' and score > 500;";
+constexpr char by_score[] = "SELECT * FROM users WHERE score BETWEEN -10 AND 100 AND country != 'uk';";
+
+//each of these fails to compile, with the message of its static_assert
+//constexpr char unknown_column[] = "SELECT id FROM users WHERE height > 10;";
+//constexpr char wrong_literal[] = "SELECT id FROM users WHERE age == 'ro';";
+//constexpr char no_from[] = "SELECT id users;";
+
+std::vector<user> make_users(std::size_t rows){
+  static const char* countries[] = { "ro", "uk", "us", "de", "fr", "it", "es", "nl" };
+
+  std::vector<user> users(rows);
+  std::mt19937 gen(42);
+  for(std::size_t i = 0; i < rows; ++i){
+    users[i].id = static_cast<int>(i);
+    users[i].age = static_cast<int>(18 + gen() % 73);
+    users[i].country = countries[gen() % 8];
+    users[i].name = "user" + std::to_string(gen() % 1000000);
+    users[i].score = static_cast<int>(gen() % 1000);
+  }
+  return users;
+}
+
+template<typename F>
+double time_ms(F f){
+  auto start = std::chrono::steady_clock::now();
+  f();
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+//g++ file.cpp -std=c++11 -O2
+//./a.out [rows]
+
+int main(int argc, char* argv[]){
+  std::size_t n = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 4000000;
+  std::vector<user> users = make_users(n);
+
+  std::cout << "\n" << n << " rows\n\n"
+            << std::left << std::setw(82) << "query" << std::right
+            << std::setw(10) << "rows" << std::setw(12) << "hand ms" << std::setw(12) << "static ms" << "\n";
+
+  auto report = [](char const* text, std::size_t hand_rows, double hand_ms, std::size_t static_rows, double static_ms){
+    std::cout << std::left << std::setw(82) << text << std::right
+              << std::setw(10) << static_rows
+              << std::setw(12) << std::fixed << std::setprecision(1) << hand_ms
+              << std::setw(12) << static_ms
+              << (hand_rows != static_rows ? "  MISMATCH" : "") << "\n";
+  };
+
+  {
+    std::size_t hand_rows = 0, static_rows = 0;
+    long long hand_sum = 0, static_sum = 0;
+    double hand_ms = time_ms([&]{
+      for(auto const& u : users){
+        if( u.age >= 30 && u.age < 60 && u.country == "ro" ){
+          ++hand_rows;
+          hand_sum += u.id + static_cast<long long>(u.name.size());
+        }
+      }
+    });
+    double static_ms = time_ms([&]{
+      static_query<user, by_age_and_country>::for_each(users, [&](int id, std::string const& name){
+        ++static_rows;
+        static_sum += id + static_cast<long long>(name.size());
+      });
+    });
+    report(by_age_and_country, hand_rows, hand_ms, hand_sum == static_sum ? static_rows : 0, static_ms);
+  }
+
+  {
+    std::size_t hand_rows = 0, static_rows = 0;
+    double hand_ms = time_ms([&]{
+      for(auto const& u : users){ hand_rows += u.name >= "user2" && u.name <= "user4" && u.score > 500; }
+    });
+    double static_ms = time_ms([&]{
+      static_query<user, by_name_range>::for_each(users, [&](int){ ++static_rows; });
+    });
+    report(by_name_range, hand_rows, hand_ms, static_rows, static_ms);
+  }
+
+  {
+    std::vector<std::tuple<int, int, std::string, std::string, int>> hand;
+    std::vector<static_query<user, by_score>::result_row> result;
+    double hand_ms = time_ms([&]{
+      for(auto const& u : users){
+        if( u.score >= -10 && u.score <= 100 && u.country != "uk" ) hand.emplace_back(u.id, u.age, u.country, u.name, u.score);
+      }
+    });
+    double static_ms = time_ms([&]{ result = static_query<user, by_score>::run(users); });
+    report(by_score, hand.size(), hand_ms, result == hand ? result.size() : 0, static_ms);
+  }
+
+  std::cout << "\nBye... :-) \n";
+  return 0;
+}
@@ -0,0 +1,75 @@
+#ifndef QI_FAST_REAL_HPP
+#define QI_FAST_REAL_HPP
+
+#include "qi_swar_int.hpp"
+#include "sql_real.hpp"
+
+#include <boost/spirit/include/qi.hpp>
+#include <boost/type_traits/is_same.hpp>
+#include <boost/utility/enable_if.hpp>
+
+#include <cstring>
+#include <iterator>
+#include <string>
+
+/*
+number_: a qi::double_ literal (sql_real.hpp) whose attribute is an int when the literal has no
+'.' and no exponent and fits in an int, a double otherwise. It replaces double_ | int_ in one
+pass: double_ accepts every int, so the int_ alternative never ran.
+
+The attribute is the real_literal; assigned to a variant holding int and double the right one is
+set, assigned to a double or an int it converts.
+*/
+
+namespace real_detail{
+  inline bool literal_char(char c){
+    return (c >= '0' && c <= '9') || (c != 0 && std::strchr("+-.eEnNaAiIfFtTyY", c) != nullptr);
+  }
+}
+
+struct number_parser : boost::spirit::qi::primitive_parser<number_parser>{
+  template<typename Context, typename Iterator>
+  struct attribute{ typedef real_literal type; };
+
+  template<typename Iterator, typename Context, typename Skipper, typename Attribute>
+  bool parse(Iterator& first, Iterator const& last, Context&, Skipper const& skipper, Attribute& attr_) const {
+    boost::spirit::qi::skip_over(first, last, skipper);
+    if( first == last ) return false;
+
+    real_literal literal;
+    std::size_t length;
+    if( char const* p = swar_detail::contiguous(first) ){
+      length = parse_real(p, static_cast<std::size_t>(std::distance(first, last)), literal);
+    }else{
+      std::string text;
+      for(Iterator it = first; it != last && real_detail::literal_char(*it); ++it){ text.push_back(*it); }
+      length = parse_real(text.data(), text.size(), literal);
+    }
+    if( length == 0 ) return false;
+
+    boost::spirit::traits::assign_to(literal, attr_);
+    std::advance(first, length);
+    return true;
+  }
+
+  template<typename Context>
+  boost::spirit::info what(Context&) const {
+    return boost::spirit::info("number");
+  }
+};
+
+const boost::proto::terminal<number_parser>::type number_ = {{}};
+
+namespace boost{ namespace spirit{ namespace traits{
+  //int or double into whatever holds the number; in an alternative this saves going through a
+  //temporary variant<double, int>
+  template<typename Attribute>
+  struct assign_to_attribute_from_value<Attribute, real_literal, typename boost::disable_if<boost::is_same<Attribute, real_literal>>::type>{
+    static void call(real_literal const& literal, Attribute& attr){
+      if( literal.integral_ ) attr = literal.int_;
+      else attr = literal.double_;
+    }
+  };
+}}}
+
+#endif
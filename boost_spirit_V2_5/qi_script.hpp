@@ -0,0 +1,92 @@
+#ifndef QI_SCRIPT_HPP
+#define QI_SCRIPT_HPP
+
+#include <boost/range/iterator_range.hpp>
+#include <boost/spirit/include/phoenix.hpp>
+#include <boost/spirit/include/qi.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <string>
+
+/*
+Script mode: a whole buffer of ';' terminated statements in one phrase_parse pass.
+
+  script_grammar<Iterator, basic_select, sql_space_type> script(statement_grammar, on_statement, on_error);
+  phrase_parse(first, last, script, sql_space);
+
+Every statement is handed to on_statement as soon as it is parsed, so a script of millions of
+statements is never held as a list of statements. A statement that does not parse is handed to
+on_error with its line, and the parse goes on after the next ';' that is not inside a string
+literal or a comment. Empty statements (";;") are skipped.
+*/
+
+struct script_error{
+  std::size_t line_;   //1 based line of the statement start
+  std::string text_;   //the statement, up to and including its ';'
+};
+
+template<typename Iterator, typename Statement, typename Skipper>
+struct script_grammar : boost::spirit::qi::grammar<Iterator, Skipper>{
+  typedef std::function<void(Statement&)> statement_handler;
+  typedef std::function<void(script_error const&)> error_handler;
+
+  template<typename StatementGrammar>
+  script_grammar(StatementGrammar const& statement, statement_handler on_statement, error_handler on_error)
+    : script_grammar::base_type(script_), on_statement_(on_statement), on_error_(on_error), counted_(), line_(1) {
+    namespace qi = boost::spirit::qi;
+    namespace phx = boost::phoenix;
+    using qi::char_;
+    using qi::eoi;
+    using qi::lit;
+
+    statement_ = statement;
+    //the rest of a bad statement, strings and comments in one piece: a ';' in them does not end it
+    skip_ = qi::raw[ qi::lexeme[ *( lit('\'') >> *~char_('\'') >> (lit('\'') | eoi)
+                                  | lit("--") >> *~char_('\n')
+                                  | lit("/*") >> *(char_ - "*/") >> (lit("*/") | eoi)
+                                  | ~char_(';') ) >> (lit(';') | eoi) ] ];
+    script_ = qi::no_skip[ qi::raw[ qi::eps ] [ phx::bind(&script_grammar::start, this, qi::_1) ] ]
+           >> *( statement_ [ phx::bind(&script_grammar::statement, this, qi::_1) ]
+                | lit(';')
+                | !eoi >> skip_ [ phx::bind(&script_grammar::error, this, qi::_1) ] ) >> eoi;
+  }
+
+  //number of statements and errors so far
+  std::size_t statements_ = 0;
+  std::size_t errors_ = 0;
+
+private:
+  void start(boost::iterator_range<Iterator> const& range){
+    statements_ = errors_ = 0;
+    counted_ = range.begin();
+    line_ = 1;
+  }
+
+  void statement(Statement& s){
+    ++statements_;
+    on_statement_(s);
+  }
+
+  void error(boost::iterator_range<Iterator> const& range){
+    ++errors_;
+    //lines are counted from the previous error on, the errors come in order
+    line_ += static_cast<std::size_t>(std::count(counted_, range.begin(), '\n'));
+    counted_ = range.begin();
+    std::string text(range.begin(), range.end());
+    text.erase(text.find_last_not_of(" \t\r\n") + 1);
+    on_error_(script_error{ line_, text });
+  }
+
+  statement_handler on_statement_;
+  error_handler on_error_;
+  Iterator counted_;
+  std::size_t line_;
+
+  boost::spirit::qi::rule<Iterator, Statement(), Skipper> statement_;
+  boost::spirit::qi::rule<Iterator, boost::iterator_range<Iterator>(), Skipper> skip_;
+  boost::spirit::qi::rule<Iterator, Skipper> script_;
+};
+
+#endif
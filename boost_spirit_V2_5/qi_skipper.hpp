@@ -0,0 +1,140 @@
+#ifndef QI_SKIPPER_HPP
+#define QI_SKIPPER_HPP
+
+#include "qi_swar_int.hpp"
+
+#include <boost/spirit/include/qi.hpp>
+
+#include <cstdint>
+#include <iterator>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*
+Skippers to use instead of ascii::space in phrase_parse and in the rules:
+  fast_space  the whitespace of ascii::space (' ', \t, \n, \v, \f, \r)
+  sql_space   the same, plus -- line comments and / * * / block comments
+
+ascii::space is asked once per character and classifies it with a call; these skip a whole run
+per call: a 256 entry table for the first characters, then 16 bytes per SSE2 compare while the
+run goes on, over char pointers and std::string iterators (any other iterator uses the table).
+
+  qi::rule<Iterator, std::string(), sql_space_type> name_;
+  phrase_parse(first, last, grammar, sql_space, attr);
+
+An unterminated block comment runs to the end of the input.
+*/
+
+namespace skip_detail{
+
+  struct space_table{
+    bool space_[256];
+    space_table() : space_() {
+      for(char c : {' ', '\t', '\n', '\v', '\f', '\r'}){ space_[static_cast<unsigned char>(c)] = true; }
+    }
+  };
+
+  const space_table spaces;
+
+  inline bool is_space(char c){ return spaces.space_[static_cast<unsigned char>(c)]; }
+
+  //length of the run of whitespace at the start of [p, p + n)
+  inline std::size_t space_run(char const* p, std::size_t n){
+    std::size_t i = 0;
+    //most runs are a single space: the table first
+    for(; i < n && i < 2; ++i){
+      if( !is_space(p[i]) ) return i;
+    }
+#if defined(__SSE2__)
+    for(; i + 16 <= n; i += 16){
+      __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p + i));
+      __m128i control = _mm_sub_epi8(v, _mm_set1_epi8('\t'));  //\t..\r to 0..4
+      __m128i space = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                                   _mm_cmpeq_epi8(_mm_min_epu8(control, _mm_set1_epi8(4)), control));
+      unsigned other = ~static_cast<unsigned>(_mm_movemask_epi8(space)) & 0xffff;
+      if( other ) return i + __builtin_ctz(other);
+    }
+#endif
+    for(; i < n && is_space(p[i]); ++i){}
+    return i;
+  }
+
+  //length of the whitespace and comments at the start of [p, p + n)
+  template<bool Comments>
+  std::size_t skip_run(char const* p, std::size_t n){
+    std::size_t i = space_run(p, n);
+    while( Comments && i + 1 < n ){
+      if( p[i] == '-' && p[i + 1] == '-' ){
+        for(i += 2; i < n && p[i] != '\n'; ++i){}
+      }else if( p[i] == '/' && p[i + 1] == '*' ){
+        for(i += 2; i + 1 < n && !(p[i] == '*' && p[i + 1] == '/'); ++i){}
+        i = (i + 1 < n) ? i + 2 : n;
+      }else{
+        break;
+      }
+      i += space_run(p + i, n - i);
+    }
+    return i;
+  }
+
+  //the same over any forward iterator
+  template<bool Comments, typename Iterator>
+  bool skip_run(Iterator& first, Iterator const& last){
+    Iterator start = first;
+    for(;;){
+      for(; first != last && is_space(*first); ++first){}
+      if( !Comments || first == last ) break;
+      Iterator next = first;
+      char c = *first;
+      if( ++next == last || (c != '-' && c != '/') || *next != (c == '-' ? '-' : '*') ) break;
+      first = ++next;
+      if( c == '-' ){
+        for(; first != last && *first != '\n'; ++first){}
+      }else{
+        for(char prev = 0; first != last; ++first){
+          if( prev == '*' && *first == '/' ){
+            ++first;
+            break;
+          }
+          prev = *first;
+        }
+      }
+    }
+    return first != start;
+  }
+}
+
+template<bool Comments>
+struct skip_parser : boost::spirit::qi::primitive_parser<skip_parser<Comments>>{
+  template<typename Context, typename Iterator>
+  struct attribute{ typedef boost::spirit::unused_type type; };
+
+  //skips the whole run; false when there was nothing to skip, which ends skip_over
+  template<typename Iterator, typename Context, typename Skipper, typename Attribute>
+  bool parse(Iterator& first, Iterator const& last, Context&, Skipper const&, Attribute&) const {
+    if( first == last ) return false;
+    //the usual case: nothing to skip
+    char c = *first;
+    if( !skip_detail::is_space(c) && (!Comments || (c != '-' && c != '/')) ) return false;
+    if( char const* p = swar_detail::contiguous(first) ){
+      std::size_t n = skip_detail::skip_run<Comments>(p, static_cast<std::size_t>(std::distance(first, last)));
+      std::advance(first, n);
+      return n != 0;
+    }
+    return skip_detail::skip_run<Comments>(first, last);
+  }
+
+  template<typename Context>
+  boost::spirit::info what(Context&) const {
+    return boost::spirit::info(Comments ? "sql-space" : "space");
+  }
+};
+
+typedef boost::proto::terminal<skip_parser<false>>::type fast_space_type;
+typedef boost::proto::terminal<skip_parser<true>>::type sql_space_type;
+const fast_space_type fast_space = {{}};
+const sql_space_type sql_space = {{}};
+
+#endif
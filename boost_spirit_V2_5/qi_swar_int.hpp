@@ -0,0 +1,98 @@
+#ifndef QI_SWAR_INT_HPP
+#define QI_SWAR_INT_HPP
+
+#include "sql_swar.hpp"
+
+#include <boost/spirit/include/qi.hpp>
+
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <type_traits>
+
+/*
+swar_int_ / swar_uint_: drop-in replacements for qi::int_ / qi::uint_ (same syntax: an optional
+sign for int_, then decimal digits; same attribute; fail on overflow) that read 8 digits per step
+with SWAR (sql_swar.hpp) instead of one multiply-add per digit.
+
+Over char pointers and std::string iterators the digits are read in place, any other iterator
+goes through a small copied window.
+*/
+
+namespace swar_detail{
+
+  //the characters at it, in place, or nullptr when the iterator is not known to be contiguous
+  inline char const* contiguous(char const* it){ return it; }
+  inline char const* contiguous(char* it){ return it; }
+  inline char const* contiguous(std::string::const_iterator it){ return &*it; }
+  inline char const* contiguous(std::string::iterator it){ return &*it; }
+  template<typename Iterator>
+  char const* contiguous(Iterator){ return nullptr; }
+
+  const std::size_t window = 32;
+}
+
+template<typename T>
+struct swar_int_parser : boost::spirit::qi::primitive_parser<swar_int_parser<T>>{
+  template<typename Context, typename Iterator>
+  struct attribute{ typedef T type; };
+
+  template<typename Iterator, typename Context, typename Skipper, typename Attribute>
+  bool parse(Iterator& first, Iterator const& last, Context&, Skipper const& skipper, Attribute& attr_) const {
+    boost::spirit::qi::skip_over(first, last, skipper);
+    if( first == last ) return false;
+
+    char buffer[swar_detail::window] = {};
+    char const* p = swar_detail::contiguous(first);
+    std::size_t n;
+    if( p ){
+      n = static_cast<std::size_t>(std::distance(first, last));
+    }else{
+      n = 0;
+      for(Iterator it = first; it != last && n < swar_detail::window; ++it){ buffer[n++] = *it; }
+      p = buffer;
+    }
+
+    std::size_t i = 0;
+    bool negative = false;
+    if( std::is_signed<T>::value && (p[0] == '-' || p[0] == '+') ){
+      negative = p[0] == '-';
+      ++i;
+    }
+    std::uint64_t value;
+    bool overflow;
+    std::size_t digits = swar_parse_digits(p + i, n - i, value, overflow);
+    if( digits == 0 ) return false;
+    i += digits;
+
+    //a copied window full of digits: the rest of the digits one at a time
+    Iterator it = first;
+    std::advance(it, i);
+    if( p == buffer && i == n ){
+      for(; it != last && *it >= '0' && *it <= '9'; ++it){
+        std::uint64_t d = static_cast<std::uint64_t>(*it - '0');
+        if( value > (~std::uint64_t(0) - d) / 10 ) overflow = true;
+        value = value * 10 + d;
+      }
+    }
+
+    std::uint64_t limit = static_cast<std::uint64_t>(std::numeric_limits<T>::max()) + (negative ? 1 : 0);
+    if( overflow || value > limit ) return false;
+    T result = negative ? static_cast<T>(-static_cast<std::int64_t>(value - 1) - 1) : static_cast<T>(value);
+    boost::spirit::traits::assign_to(result, attr_);
+    first = it;
+    return true;
+  }
+
+  template<typename Context>
+  boost::spirit::info what(Context&) const {
+    return boost::spirit::info(std::is_signed<T>::value ? "swar-integer" : "swar-unsigned-integer");
+  }
+};
+
+//proto terminals, so that they compose with the other parsers: swar_int_ % ','
+const boost::proto::terminal<swar_int_parser<int>>::type swar_int_ = {{}};
+const boost::proto::terminal<swar_int_parser<unsigned>>::type swar_uint_ = {{}};
+
+#endif
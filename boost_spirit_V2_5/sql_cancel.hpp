@@ -0,0 +1,91 @@
+#ifndef SQL_CANCEL_HPP
+#define SQL_CANCEL_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+
+/*
+Query cancellation and deadlines.
+
+Every query runs under a query_token: cancel() may be called from any thread (or a signal handler)
+and the deadline is checked together with the flag. The token is installed for the calling thread
+with a query_scope, run_workers hands it on to its workers (see sql_parallel.hpp).
+
+The scan, filter and aggregate loops poll query_stopped() before every morsel and every batch inside
+a morsel, the sort, join and materialization loops every few thousand items, so a stopped query gives
+its workers back within a batch; once they have returned, check_query() throws query_cancelled on
+the calling thread.
+*/
+
+class query_token{
+public:
+  using clock = std::chrono::steady_clock;
+
+  //a zero timeout means no deadline
+  explicit query_token(clock::duration timeout = clock::duration::zero())
+    : cancelled_(false), deadline_(timeout > clock::duration::zero() ? clock::now() + timeout : clock::time_point::max()) {}
+
+  void cancel(){ cancelled_.store(true, std::memory_order_relaxed); }
+
+  bool cancelled() const { return cancelled_.load(std::memory_order_relaxed); }
+
+  bool stopped() const { return cancelled() || clock::now() >= deadline_; }
+
+  //called by the workers between morsels; a scheduler may block them there to give the cores to a
+  //more urgent query (see sql_scheduler.hpp)
+  void set_yield(std::function<void()> yield){ yield_ = std::move(yield); }
+
+  void yield() const { if( yield_ ) yield_(); }
+
+private:
+  std::atomic<bool> cancelled_;
+  clock::time_point deadline_;
+  std::function<void()> yield_;
+};
+
+struct query_cancelled : std::runtime_error{
+  explicit query_cancelled(query_token const& token)
+    : std::runtime_error(token.cancelled() ? "query cancelled" : "query deadline exceeded") {}
+};
+
+//the token of the query the calling thread works for, null outside of queries
+inline query_token const*& current_query(){
+  static thread_local query_token const* token = nullptr;
+  return token;
+}
+
+//installs a token for the calling thread, the previous one is restored on the way out
+class query_scope{
+public:
+  explicit query_scope(query_token const* token) : previous_(current_query()) { current_query() = token; }
+  ~query_scope(){ current_query() = previous_; }
+
+  query_scope(query_scope const&) = delete;
+  query_scope& operator=(query_scope const&) = delete;
+
+private:
+  query_token const* previous_;
+};
+
+inline bool query_stopped(){
+  query_token const* token = current_query();
+  return token && token->stopped();
+}
+
+//for tight loops over items: only every 4096th item polls the token
+inline bool query_stopped_at(std::size_t i){
+  return (i & 0xfff) == 0 && query_stopped();
+}
+
+inline void query_yield(){
+  if( query_token const* token = current_query() ) token->yield();
+}
+
+inline void check_query(){
+  if( query_stopped() ) throw query_cancelled(*current_query());
+}
+
+#endif
@@ -0,0 +1,348 @@
+#ifndef SQL_COLFILE_HPP
+#define SQL_COLFILE_HPP
+
+#include "sql_hash_agg.hpp"
+#include "sql_table.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+Columnar table files, laid out so that a table can be used straight from a read only mapping.
+
+  "COLF" version
+  pages            every column array of every block, each one starting on a 64 byte boundary
+  footer           schema, then per block: rows and per column the encoding, the statistics
+                   (min, max, null count, sorted) and the (offset, count) of its pages:
+                     int columns      values, packed words, run ends (sql_compress.hpp), validity
+                     string columns   offsets, heap, codes, validity
+  footer offset, footer size, "COLF"
+
+Opening a file reads the trailer and the footer only; the blocks borrow their arrays from the
+mapping, so a query faults in the pages of the columns (and blocks) it actually reads. Blocks that
+the statistics rule out are never touched at all. For the same reason opening only checks what
+the footer tells (page bounds, array sizes, the last string offset); the string offsets, the
+dictionary codes and the run ends are checked as they are read, a query reading a corrupt column
+fails with an error.
+
+Int columns keep the compressed encoding they were sealed with, so a mapped column is scanned
+compressed as well. String columns with few distinct values per block (at most a quarter of the
+rows) are written dictionary encoded. Validity bitmaps are written only for the columns that hold nulls.
+Numbers are stored in the native byte order: the files are a cache for this machine, not an
+interchange format.
+*/
+
+const std::uint32_t colfile_version = 3;
+const std::size_t colfile_alignment = 64;
+
+//string columns; int columns store their int_encoding
+enum colfile_encoding { enc_plain = 0, enc_dictionary = 1 };
+
+namespace colfile_detail{
+
+  struct page_ref{
+    std::uint64_t offset_;
+    std::uint64_t count_;
+  };
+
+  class writer{
+  public:
+    explicit writer(std::string const& path) : out_(path.c_str(), std::ios::binary | std::ios::trunc), pos_(0) {
+      if( !out_ ) throw std::runtime_error("can not write " + path);
+    }
+
+    template<typename T>
+    void put(T v){ write(&v, sizeof(v)); }
+
+    void put(std::string const& s){
+      put(static_cast<std::uint32_t>(s.size()));
+      write(s.data(), s.size());
+    }
+
+    template<typename T>
+    page_ref page(T const* p, std::size_t n){
+      if( n == 0 ) return page_ref{0, 0};
+      static const char zeros[colfile_alignment] = {};
+      write(zeros, (colfile_alignment - pos_ % colfile_alignment) % colfile_alignment);
+      page_ref ref{pos_, n};
+      write(p, n * sizeof(T));
+      return ref;
+    }
+
+    void put(page_ref ref){
+      put(ref.offset_);
+      put(ref.count_);
+    }
+
+    std::uint64_t pos() const { return pos_; }
+
+    void write(void const* p, std::size_t n){
+      out_.write(static_cast<char const*>(p), n);
+      pos_ += n;
+    }
+
+    void close(){
+      out_.close();
+      if( !out_ ) throw std::runtime_error("writing the table file failed");
+    }
+
+  private:
+    std::ofstream out_;
+    std::uint64_t pos_;
+  };
+
+  //bounds checked reads of the footer
+  class reader{
+  public:
+    reader(char const* p, std::size_t n) : p_(p), end_(p + n) {}
+
+    template<typename T>
+    T get(){
+      T v;
+      read(&v, sizeof(v));
+      return v;
+    }
+
+    std::string get_string(){
+      std::uint32_t n = get<std::uint32_t>();
+      if( static_cast<std::size_t>(end_ - p_) < n ) throw std::runtime_error("corrupt table file");
+      std::string s(p_, n);
+      p_ += n;
+      return s;
+    }
+
+    page_ref get_page(){
+      page_ref ref;
+      ref.offset_ = get<std::uint64_t>();
+      ref.count_ = get<std::uint64_t>();
+      return ref;
+    }
+
+  private:
+    void read(void* v, std::size_t n){
+      if( static_cast<std::size_t>(end_ - p_) < n ) throw std::runtime_error("corrupt table file");
+      std::memcpy(v, p_, n);
+      p_ += n;
+    }
+
+    char const* p_;
+    char const* end_;
+  };
+
+  //the distinct strings of a block and the code of every row, or false if there are too many
+  inline bool dictionary_encode(string_column const& col, std::size_t rows, string_column& dict, std::vector<std::uint32_t>& codes){
+    group_table distinct;
+    codes.resize(rows);
+    for(std::size_t r = 0; r < rows; ++r){
+      boost::string_ref s = col.get(r);
+      codes[r] = distinct.find_or_insert(s, hash_bytes(s));
+      if( distinct.size() > rows / 4 ) return false;
+    }
+    for(std::uint32_t e = 0; e < distinct.size(); ++e){ dict.push_back(distinct.key(e)); }
+    return true;
+  }
+
+  template<typename T>
+  void borrow(column_array<T>& array, char const* base, std::size_t size, page_ref ref){
+    if( ref.count_ == 0 ) return;
+    if( ref.offset_ % colfile_alignment || ref.offset_ > size || ref.count_ > (size - ref.offset_) / sizeof(T) )
+      throw std::runtime_error("corrupt table file");
+    array.borrow(reinterpret_cast<T const*>(base + ref.offset_), ref.count_);
+  }
+
+  //the arrays have the sizes their encoding implies
+  inline bool valid_ints(int_column const& c){
+    std::size_t groups = (c.size_ + pack_group - 1) / pack_group;
+    switch( c.encoding_ ){
+      case int_plain: return c.values_.size() == c.size_ && c.words_.empty() && c.ends_.empty();
+      case int_rle: return !c.ends_.empty() && c.values_.size() == c.ends_.size() && c.ends_[c.ends_.size() - 1] == c.size_;
+      case int_for: return c.words_.size() == compress_detail::packed_words(c.size_, c.bits_);
+      default: return c.values_.size() == groups && c.words_.size() == compress_detail::packed_words(c.size_, c.bits_);
+    }
+  }
+
+  //the offsets end with the heap; the offsets and codes in between are checked as they are read
+  inline bool valid_strings(string_column const& s){
+    return !s.offsets_.empty() && s.offsets_[s.offsets_.size() - 1] == s.heap_.size();
+  }
+
+  const char magic[4] = { 'C', 'O', 'L', 'F' };
+  const std::size_t trailer_bytes = 2 * sizeof(std::uint64_t) + sizeof(magic);
+}
+
+inline void write_colfile(table_data const& table, std::string const& path){
+  using namespace colfile_detail;
+
+  struct chunk_meta{
+    std::uint8_t encoding_;
+    page_ref pages_[3];
+    page_ref validity_;
+  };
+  std::vector<std::vector<chunk_meta>> metas(table.blocks_.size());
+
+  writer out(path);
+  out.write(magic, sizeof(magic));
+  out.put(colfile_version);
+
+  //the pages, block by block so that a block is contiguous in the file
+  for(std::size_t b = 0; b < table.blocks_.size(); ++b){
+    table_block const& block = *table.blocks_[b];
+    for(auto& col : block.columns_){
+      chunk_meta meta = chunk_meta();
+      meta.encoding_ = enc_plain;
+      if( col.kind_ == col_int ){
+        meta.encoding_ = static_cast<std::uint8_t>(col.ints_.encoding_);
+        meta.pages_[0] = out.page(col.ints_.values_.data(), col.ints_.values_.size());
+        meta.pages_[1] = out.page(col.ints_.words_.data(), col.ints_.words_.size());
+        meta.pages_[2] = out.page(col.ints_.ends_.data(), col.ints_.ends_.size());
+      }else{
+        string_column dict;
+        std::vector<std::uint32_t> codes;
+        string_column const* strings = &col.strings_;
+        if( col.strings_.dictionary() || dictionary_encode(col.strings_, block.rows_, dict, codes) ){
+          meta.encoding_ = enc_dictionary;
+          if( !col.strings_.dictionary() ){
+            dict.codes_.append(codes.data(), codes.size());
+            strings = &dict;
+          }
+        }
+        meta.pages_[0] = out.page(strings->offsets_.data(), strings->offsets_.size());
+        meta.pages_[1] = out.page(strings->heap_.data(), strings->heap_.size());
+        meta.pages_[2] = out.page(strings->codes_.data(), strings->codes_.size());
+      }
+      if( col.null_count_ ) meta.validity_ = out.page(col.validity_.data(), col.validity_.size());
+      metas[b].push_back(meta);
+    }
+  }
+
+  std::uint64_t footer = out.pos();
+  table_schema const& schema = table.schema_;
+  out.put(static_cast<std::uint32_t>(schema.names_.size()));
+  for(std::size_t c = 0; c < schema.names_.size(); ++c){
+    out.put(static_cast<std::uint8_t>(schema.kinds_[c]));
+    out.put(schema.names_[c]);
+  }
+  out.put(static_cast<std::uint64_t>(table.blocks_.size()));
+  for(std::size_t b = 0; b < table.blocks_.size(); ++b){
+    table_block const& block = *table.blocks_[b];
+    out.put(static_cast<std::uint64_t>(block.rows_));
+    for(std::size_t c = 0; c < block.columns_.size(); ++c){
+      column_chunk const& col = block.columns_[c];
+      chunk_meta const& meta = metas[b][c];
+      out.put(meta.encoding_);
+      out.put(static_cast<std::uint8_t>(col.kind_ == col_int ? col.ints_.bits_ : 0));
+      out.put(static_cast<std::int32_t>(col.kind_ == col_int ? col.ints_.base_ : 0));
+      out.put(static_cast<std::int32_t>(col.min_));
+      out.put(static_cast<std::int32_t>(col.max_));
+      out.put(static_cast<std::uint64_t>(col.null_count_));
+      out.put(static_cast<std::uint8_t>(col.sorted_));
+      for(auto ref : { meta.pages_[0], meta.pages_[1], meta.pages_[2], meta.validity_ }){ out.put(ref); }
+    }
+  }
+  std::uint64_t footer_size = out.pos() - footer;
+  out.put(footer);
+  out.put(footer_size);
+  out.write(magic, sizeof(magic));
+  out.close();
+}
+
+//maps a table file; the returned blocks keep the mapping alive
+inline table_data open_colfile(std::string const& path){
+  using namespace colfile_detail;
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if( fd < 0 ) throw std::runtime_error("can not open " + path);
+  struct stat st;
+  if( ::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < 8 + trailer_bytes ){
+    ::close(fd);
+    throw std::runtime_error("not a table file: " + path);
+  }
+  std::size_t size = static_cast<std::size_t>(st.st_size);
+  void* addr = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if( addr == MAP_FAILED ) throw std::runtime_error("can not map " + path);
+  std::shared_ptr<void const> mapping(addr, [size](void const* p){ ::munmap(const_cast<void*>(p), size); });
+  char const* base = static_cast<char const*>(addr);
+
+  reader trailer(base + size - trailer_bytes, trailer_bytes);
+  std::uint64_t footer = trailer.get<std::uint64_t>();
+  std::uint64_t footer_size = trailer.get<std::uint64_t>();
+  if( std::memcmp(base, magic, sizeof(magic)) || std::memcmp(base + size - sizeof(magic), magic, sizeof(magic)) )
+    throw std::runtime_error("not a table file: " + path);
+  std::uint32_t version;
+  std::memcpy(&version, base + sizeof(magic), sizeof(version));
+  if( version != colfile_version ) throw std::runtime_error("unsupported table file version: " + path);
+  if( footer > size - trailer_bytes || footer_size != size - trailer_bytes - footer ) throw std::runtime_error("corrupt table file: " + path);
+
+  reader in(base + footer, footer_size);
+  table_data table;
+  std::uint32_t columns = in.get<std::uint32_t>();
+  for(std::uint32_t c = 0; c < columns; ++c){
+    std::uint8_t kind = in.get<std::uint8_t>();
+    if( kind > col_string ) throw std::runtime_error("corrupt table file: " + path);
+    table.schema_.kinds_.push_back(static_cast<column_kind>(kind));
+    table.schema_.names_.push_back(in.get_string());
+  }
+
+  std::uint64_t blocks = in.get<std::uint64_t>();
+  for(std::uint64_t b = 0; b < blocks; ++b){
+    std::shared_ptr<table_block> block(new table_block());
+    block->rows_ = in.get<std::uint64_t>();
+    block->backing_ = mapping;
+    for(std::uint32_t c = 0; c < columns; ++c){
+      column_chunk chunk;
+      chunk.kind_ = table.schema_.kinds_[c];
+      std::uint8_t encoding = in.get<std::uint8_t>();
+      std::uint8_t bits = in.get<std::uint8_t>();
+      std::int32_t frame = in.get<std::int32_t>();
+      chunk.min_ = in.get<std::int32_t>();
+      chunk.max_ = in.get<std::int32_t>();
+      chunk.null_count_ = in.get<std::uint64_t>();
+      chunk.sorted_ = in.get<std::uint8_t>() != 0;
+      page_ref pages[3];
+      for(auto& ref : pages){ ref = in.get_page(); }
+      page_ref validity = in.get_page();
+
+      std::size_t expected = 0;
+      if( chunk.kind_ == col_int ){
+        int_column& ints = chunk.ints_;
+        if( encoding > int_delta || bits > 32 ) throw std::runtime_error("corrupt table file: " + path);
+        ints.encoding_ = static_cast<int_encoding>(encoding);
+        ints.bits_ = bits;
+        ints.base_ = frame;
+        ints.size_ = block->rows_;
+        borrow(ints.values_, base, size, pages[0]);
+        borrow(ints.words_, base, size, pages[1]);
+        borrow(ints.ends_, base, size, pages[2]);
+        if( !valid_ints(ints) ) throw std::runtime_error("corrupt table file: " + path);
+        expected = ints.size();
+      }else{
+        borrow(chunk.strings_.offsets_, base, size, pages[0]);
+        borrow(chunk.strings_.heap_, base, size, pages[1]);
+        borrow(chunk.strings_.codes_, base, size, pages[2]);
+        if( (encoding == enc_dictionary) != chunk.strings_.dictionary() || !valid_strings(chunk.strings_) )
+          throw std::runtime_error("corrupt table file: " + path);
+        expected = chunk.strings_.size();
+      }
+      borrow(chunk.validity_, base, size, validity);
+      if( expected != block->rows_ || (chunk.null_count_ && chunk.validity_.size() != (block->rows_ + 63) / 64) )
+        throw std::runtime_error("corrupt table file: " + path);
+      block->columns_.push_back(std::move(chunk));
+    }
+    table.blocks_.push_back(block);
+  }
+  return table;
+}
+
+#endif
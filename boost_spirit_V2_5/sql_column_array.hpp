@@ -0,0 +1,64 @@
+#ifndef SQL_COLUMN_ARRAY_HPP
+#define SQL_COLUMN_ARRAY_HPP
+
+#include <cstddef>
+#include <vector>
+
+//a contiguous array, owned or borrowed; only owned arrays can grow
+template<typename T>
+class column_array{
+public:
+  column_array() : data_(nullptr), size_(0) {}
+
+  column_array(column_array const& other) : owned_(other.owned_), data_(other.data_), size_(other.size_) {
+    if( other.owns() ) data_ = owned_.data();
+  }
+
+  column_array(column_array&& other) : data_(other.data_), size_(other.size_) {
+    bool owned = other.owns();
+    owned_.swap(other.owned_);
+    if( owned ) data_ = owned_.data();
+    other.sync();
+  }
+
+  column_array& operator=(column_array other){
+    bool owned = other.owns();
+    owned_.swap(other.owned_);
+    data_ = owned ? owned_.data() : other.data_;
+    size_ = other.size_;
+    return *this;
+  }
+
+  T const& operator[](std::size_t i) const { return data_[i]; }
+  T const* data() const { return data_; }
+  T const* begin() const { return data_; }
+  T const* end() const { return data_ + size_; }
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  void reserve(std::size_t n){ owned_.reserve(n); sync(); }
+
+  void push_back(T const& v){ owned_.push_back(v); sync(); }
+
+  void append(T const* p, std::size_t n){ owned_.insert(owned_.end(), p, p + n); sync(); }
+
+  void resize(std::size_t n, T const& v){ owned_.resize(n, v); sync(); }
+
+  T& mutable_at(std::size_t i){ return owned_[i]; }
+
+  void borrow(T const* p, std::size_t n){
+    owned_.clear();
+    data_ = p;
+    size_ = n;
+  }
+
+private:
+  bool owns() const { return data_ == owned_.data() && !(data_ == nullptr && size_); }
+  void sync(){ data_ = owned_.data(); size_ = owned_.size(); }
+
+  std::vector<T> owned_;
+  T const* data_;
+  std::size_t size_;
+};
+
+#endif
@@ -0,0 +1,520 @@
+#ifndef SQL_COMPRESS_HPP
+#define SQL_COMPRESS_HPP
+
+#include "sql_column_array.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+/*
+Lightweight compression of int columns, chosen per block when the block is sealed:
+
+  plain   the values
+  rle     run values + run ends, for columns made of long runs
+  for     frame of reference: value - min, bit packed with just enough bits for max - min
+  delta   value - previous value, frame of reference + bit packed as well, with the first value
+          of every group of 128 kept as a checkpoint; sorted or clustered columns (ids) shrink to
+          a few bits (0 bits for a constant stride)
+
+whichever is smallest. Bit packed codes are laid out in groups of 128 values spread over 4 lanes
+of 32 bit words (value i is in lane i % 4), so that SSE2 unpacks 4 codes per shift and mask, and
+any single code is still one or two word reads away.
+
+Random access (operator[]) works for every encoding; on delta columns it decodes the whole group
+and keeps the last two groups decoded by the thread, so rows read in order (or two rows compared
+back and forth) cost one decode per group rather than one per row. Scans go through decode() a range at a time
+and match() evaluates lo <= value <= hi directly on the compressed data: frame of reference codes
+are compared with the codes of the bounds without being decoded, runs are compared once per run.
+A range test is one unsigned compare, (value - lo) <= (hi - lo), so == and the range operators run
+the same branch free SIMD loop. bound() binary searches a column known to be sorted.
+gather() reads the values of a list of rows only: 8 at a time with the AVX2 gather on plain
+columns, one decode per touched group or one walk over the runs on the others.
+*/
+
+enum int_encoding { int_plain, int_rle, int_for, int_delta };
+
+const std::size_t pack_group = 128;
+
+namespace compress_detail{
+
+  inline std::uint32_t low_mask(unsigned bits){ return bits >= 32 ? 0xffffffffu : (1u << bits) - 1; }
+
+  inline unsigned bit_width(std::uint64_t range){
+    unsigned bits = 0;
+    while( bits < 64 && (range >> bits) ){ ++bits; }
+    return bits;
+  }
+
+  inline std::size_t packed_words(std::size_t n, unsigned bits){
+    return bits ? ((n + pack_group - 1) / pack_group) * 4 * bits + 4 : 0;
+  }
+
+  //word and shift of code i inside the packed array
+  inline std::size_t code_word(std::size_t i, unsigned bits, unsigned& shift){
+    std::size_t bit = ((i >> 2) & 31) * bits;
+    shift = bit & 31;
+    return (i >> 7) * 4 * bits + (bit >> 5) * 4 + (i & 3);
+  }
+
+  //the last 4 words are padding, so the second word of the last code can always be read
+  inline void pack(std::uint32_t const* codes, std::size_t n, unsigned bits, column_array<std::uint32_t>& words){
+    words.resize(packed_words(n, bits), 0);
+    if( !bits ) return;
+    for(std::size_t i = 0; i < n; ++i){
+      unsigned shift;
+      std::size_t w = code_word(i, bits, shift);
+      words.mutable_at(w) |= codes[i] << shift;
+      if( shift + bits > 32 ) words.mutable_at(w + 4) |= codes[i] >> (32 - shift);
+    }
+  }
+
+  inline std::uint32_t unpack_one(std::uint32_t const* words, unsigned bits, std::size_t i){
+    if( !bits ) return 0;
+    unsigned shift;
+    std::size_t w = code_word(i, bits, shift);
+    std::uint64_t pair = words[w] | (std::uint64_t(words[w + 4]) << 32);
+    return static_cast<std::uint32_t>(pair >> shift) & low_mask(bits);
+  }
+
+  //an id no other column had: a new one for every column built, copied or assigned, so that a
+  //column reusing the memory of a freed one never finds the freed one's groups in the cache
+  class column_id{
+  public:
+    column_id() : id_(next()) {}
+    column_id(column_id const&) : id_(next()) {}
+    column_id& operator=(column_id const&){
+      id_ = next();
+      return *this;
+    }
+
+    std::uint64_t get() const { return id_; }
+
+  private:
+    static std::uint64_t next(){
+      static std::atomic<std::uint64_t> ids(1);
+      return ids.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::uint64_t id_;
+  };
+
+  //the last two groups of delta columns decoded by the thread, for operator[]
+  struct group_cache{
+    std::uint64_t column_[2] = { 0, 0 };
+    std::size_t group_[2] = { 0, 0 };
+    std::uint32_t values_[2][pack_group];
+    unsigned last_ = 0;
+  };
+
+  inline group_cache& delta_cache(){
+    thread_local group_cache cache;
+    return cache;
+  }
+
+  //the 128 codes of group g
+  inline void unpack_group(std::uint32_t const* words, unsigned bits, std::size_t g, std::uint32_t* out){
+    if( !bits ){
+      std::fill(out, out + pack_group, 0u);
+      return;
+    }
+    std::uint32_t const* w = words + g * 4 * bits;
+#if defined(__SSE2__)
+    __m128i mask = _mm_set1_epi32(static_cast<int>(low_mask(bits)));
+    __m128i cur = _mm_loadu_si128(reinterpret_cast<__m128i const*>(w));
+    unsigned shift = 0;
+    for(unsigned k = 0; k < 32; ++k){
+      __m128i v = _mm_srl_epi32(cur, _mm_cvtsi32_si128(static_cast<int>(shift)));
+      shift += bits;
+      if( shift > 32 ){
+        w += 4;
+        cur = _mm_loadu_si128(reinterpret_cast<__m128i const*>(w));
+        shift -= 32;
+        v = _mm_or_si128(v, _mm_sll_epi32(cur, _mm_cvtsi32_si128(static_cast<int>(bits - shift))));
+      }else if( shift == 32 ){
+        w += 4;
+        cur = _mm_loadu_si128(reinterpret_cast<__m128i const*>(w));
+        shift = 0;
+      }
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4 * k), _mm_and_si128(v, mask));
+    }
+#else
+    for(std::size_t i = 0; i < pack_group; ++i){ out[i] = unpack_one(words, bits, g * pack_group + i); }
+#endif
+  }
+
+#if defined(__SSE2__)
+  //4 bits, (x[k] - lo) <= width unsigned: SSE2 only compares signed, so both sides get the sign
+  //bit flipped
+  inline unsigned in_range4(__m128i x, __m128i lo, __m128i width_flipped){
+    const __m128i sign = _mm_set1_epi32(static_cast<int>(0x80000000u));
+    __m128i above = _mm_cmpgt_epi32(_mm_xor_si128(_mm_sub_epi32(x, lo), sign), width_flipped);
+    return ~static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(above))) & 0xf;
+  }
+#endif
+
+  //bits[j / 64] bit j % 64 = (codes[j] - lo <= width), for the 128 codes of a group
+  inline void range_bits(std::uint32_t const* codes, std::uint32_t lo, std::uint32_t width, std::uint64_t* bits){
+#if defined(__SSE2__)
+    __m128i l = _mm_set1_epi32(static_cast<int>(lo));
+    __m128i w = _mm_set1_epi32(static_cast<int>(width ^ 0x80000000u));
+    for(unsigned half = 0; half < 2; ++half){
+      std::uint64_t word = 0;
+      for(unsigned k = 0; k < 16; ++k){
+        __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(codes + 64 * half + 4 * k));
+        word |= std::uint64_t(in_range4(v, l, w)) << (4 * k);
+      }
+      bits[half] = word;
+    }
+#else
+    for(unsigned half = 0; half < 2; ++half){
+      std::uint64_t word = 0;
+      for(unsigned j = 0; j < 64; ++j){ word |= std::uint64_t(codes[64 * half + j] - lo <= width) << j; }
+      bits[half] = word;
+    }
+#endif
+  }
+}
+
+//an int column of one block, see above
+struct int_column{
+  int_encoding encoding_ = int_plain;
+  unsigned bits_ = 0;
+  int base_ = 0;           //for: the minimum, delta: the minimum difference
+  std::size_t size_ = 0;   //rows, for the compressed encodings
+
+  column_array<int> values_;            //plain: the values, rle: run values, delta: checkpoints
+  column_array<std::uint32_t> words_;   //for, delta: the bit packed codes
+  column_array<std::uint32_t> ends_;    //rle: exclusive end row of every run
+
+  compress_detail::column_id id_;
+
+  //building, plain only
+  void reserve(std::size_t n){ values_.reserve(n); }
+  void push_back(int v){ values_.push_back(v); }
+
+  std::size_t size() const { return encoding_ == int_plain ? values_.size() : size_; }
+
+  std::size_t bytes() const {
+    return values_.size() * sizeof(int) + words_.size() * sizeof(std::uint32_t) + ends_.size() * sizeof(std::uint32_t);
+  }
+
+  //rle: the run holding row i; the run ends of a mapped column are checked as they are read, not
+  //when the file is opened
+  std::size_t run_of(std::size_t i) const {
+    std::size_t r = std::upper_bound(ends_.begin(), ends_.end(), static_cast<std::uint32_t>(i)) - ends_.begin();
+    if( r == ends_.size() || ends_[r] <= i || (r && ends_[r - 1] > i) ) throw std::runtime_error("corrupt int column");
+    return r;
+  }
+
+  int operator[](std::size_t i) const {
+    using namespace compress_detail;
+    switch( encoding_ ){
+      case int_plain: return values_[i];
+      case int_rle: return values_[run_of(i)];
+      case int_for: return static_cast<int>(static_cast<std::uint32_t>(base_) + unpack_one(words_.data(), bits_, i));
+      default: break;
+    }
+    std::size_t g = i / pack_group;
+    if( !bits_ ) return static_cast<int>(static_cast<std::uint32_t>(values_[g]) + static_cast<std::uint32_t>(base_) * static_cast<std::uint32_t>(i % pack_group));
+    group_cache& cache = delta_cache();
+    for(unsigned e = 0; e < 2; ++e){
+      if( cache.column_[e] == id_.get() && cache.group_[e] == g ){
+        cache.last_ = e;
+        return static_cast<int>(cache.values_[e][i % pack_group]);
+      }
+    }
+    unsigned e = cache.last_ ^ 1;
+    decode_group(g, cache.values_[e]);
+    cache.column_[e] = id_.get();
+    cache.group_[e] = g;
+    cache.last_ = e;
+    return static_cast<int>(cache.values_[e][i % pack_group]);
+  }
+
+  //out[0, n) = values [from, from + n)
+  void decode(std::size_t from, std::size_t n, int* out) const {
+    if( n == 0 ) return;
+    if( encoding_ == int_plain ){
+      std::memcpy(out, values_.data() + from, n * sizeof(int));
+      return;
+    }
+    if( encoding_ == int_rle ){
+      std::size_t r = run_of(from);
+      for(std::size_t i = from; i < from + n; ++r){
+        if( r == ends_.size() || ends_[r] <= i ) throw std::runtime_error("corrupt int column");
+        std::size_t end = std::min<std::size_t>(ends_[r], from + n);
+        std::fill(out + (i - from), out + (end - from), values_[r]);
+        i = end;
+      }
+      return;
+    }
+    std::uint32_t group[pack_group];
+    for(std::size_t g = from / pack_group; g * pack_group < from + n; ++g){
+      decode_group(g, group);
+      std::size_t lo = std::max(from, g * pack_group), hi = std::min(from + n, (g + 1) * pack_group);
+      std::memcpy(out + (lo - from), group + (lo - g * pack_group), (hi - lo) * sizeof(int));
+    }
+  }
+
+  //the values [from, from + n): straight from the column when it is plain, else decoded into buffer
+  int const* span(std::size_t from, std::size_t n, std::vector<int>& buffer) const {
+    if( encoding_ == int_plain ) return values_.data() + from;
+    buffer.resize(n);
+    decode(from, n, buffer.data());
+    return buffer.data();
+  }
+
+  //out[k] = value rows[k] for k < n; ascending rows decode every group once and walk the runs once
+  void gather(std::uint32_t const* rows, std::size_t n, int* out) const {
+    using namespace compress_detail;
+    std::size_t k = 0;
+    switch( encoding_ ){
+      case int_plain:
+#if defined(__AVX2__)
+        for(; k + 8 <= n; k += 8){
+          __m256i ids = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(rows + k));
+          _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + k), _mm256_i32gather_epi32(values_.data(), ids, 4));
+        }
+#endif
+        for(; k < n; ++k){ out[k] = values_[rows[k]]; }
+        return;
+      case int_for:
+        for(; k < n; ++k){ out[k] = static_cast<int>(static_cast<std::uint32_t>(base_) + unpack_one(words_.data(), bits_, rows[k])); }
+        return;
+      case int_rle: {
+        std::size_t r = 0;
+        for(; k < n; ++k){
+          if( k == 0 || rows[k] < rows[k - 1] ) r = run_of(rows[k]);
+          else while( ends_[r] <= rows[k] ){ ++r; }
+          out[k] = values_[r];
+        }
+        return;
+      }
+      default: break;
+    }
+    std::uint32_t group[pack_group];
+    std::size_t current = std::numeric_limits<std::size_t>::max();
+    for(; k < n; ++k){
+      std::size_t g = rows[k] / pack_group;
+      if( g != current ) decode_group(current = g, group);
+      out[k] = static_cast<int>(group[rows[k] % pack_group]);
+    }
+  }
+
+  //bits[j / 64] bit j % 64 = (lo <= value[from + j] <= hi) for j < n; from has to be a multiple of 128
+  void match(int lo, int hi, std::size_t from, std::size_t n, std::uint64_t* bits) const {
+    using namespace compress_detail;
+    std::size_t words = (n + 63) / 64;
+    std::fill(bits, bits + words, std::uint64_t(0));
+    if( n == 0 || lo > hi ) return;
+    std::uint32_t width = static_cast<std::uint32_t>(hi) - static_cast<std::uint32_t>(lo);
+
+    switch( encoding_ ){
+      case int_plain:{
+        std::uint32_t const* p = reinterpret_cast<std::uint32_t const*>(values_.data() + from);
+        std::uint32_t l = static_cast<std::uint32_t>(lo);
+        std::size_t i = 0;
+#if defined(__SSE2__)
+        __m128i vl = _mm_set1_epi32(lo);
+        __m128i vw = _mm_set1_epi32(static_cast<int>(width ^ 0x80000000u));
+        for(; i + 4 <= n; i += 4){
+          __m128i x = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p + i));
+          bits[i >> 6] |= std::uint64_t(in_range4(x, vl, vw)) << (i & 63);
+        }
+#endif
+        for(; i < n; ++i){ bits[i >> 6] |= std::uint64_t(p[i] - l <= width) << (i & 63); }
+        return;
+      }
+      case int_rle:{
+        std::size_t r = run_of(from);
+        for(std::size_t i = from; i < from + n; ++r){
+          if( r == ends_.size() || ends_[r] <= i ) throw std::runtime_error("corrupt int column");
+          std::size_t end = std::min<std::size_t>(ends_[r], from + n);
+          if( lo <= values_[r] && values_[r] <= hi ){
+            for(std::size_t j = i - from; j < end - from; ++j){ bits[j >> 6] |= std::uint64_t(1) << (j & 63); }
+          }
+          i = end;
+        }
+        return;
+      }
+      case int_for:{
+        //the codes of the bounds, clipped to the frame
+        std::int64_t code_lo = std::max<std::int64_t>(static_cast<std::int64_t>(lo) - base_, 0);
+        std::int64_t code_hi = std::min<std::int64_t>(static_cast<std::int64_t>(hi) - base_, low_mask(bits_));
+        if( code_lo > code_hi ) return;
+        std::uint32_t group[pack_group];
+        std::uint64_t group_bits[2];
+        for(std::size_t g = from / pack_group; g * pack_group < from + n; ++g){
+          unpack_group(words_.data(), bits_, g, group);
+          range_bits(group, static_cast<std::uint32_t>(code_lo), static_cast<std::uint32_t>(code_hi - code_lo), group_bits);
+          std::size_t w = (g * pack_group - from) / 64;
+          bits[w] = group_bits[0];
+          if( w + 1 < words ) bits[w + 1] = group_bits[1];
+        }
+        break;
+      }
+      default:{
+        std::uint32_t group[pack_group];
+        std::uint64_t group_bits[2];
+        for(std::size_t g = from / pack_group; g * pack_group < from + n; ++g){
+          decode_group(g, group);
+          range_bits(group, static_cast<std::uint32_t>(lo), width, group_bits);
+          std::size_t w = (g * pack_group - from) / 64;
+          bits[w] = group_bits[0];
+          if( w + 1 < words ) bits[w + 1] = group_bits[1];
+        }
+        break;
+      }
+    }
+    //the codes past the last row are padding
+    if( n & 63 ) bits[words - 1] &= (std::uint64_t(1) << (n & 63)) - 1;
+  }
+
+  //for a column sorted in non decreasing order: the first row whose value is not less than v, or
+  //with upper the first row whose value is greater than v
+  std::size_t bound(int v, bool upper) const {
+    auto before = [&](int x){ return upper ? x <= v : x < v; };
+    switch( encoding_ ){
+      case int_plain: return std::partition_point(values_.begin(), values_.end(), before) - values_.begin();
+      case int_rle:{
+        std::size_t r = std::partition_point(values_.begin(), values_.end(), before) - values_.begin();
+        return r ? ends_[r - 1] : 0;
+      }
+      case int_delta:{
+        //the checkpoints narrow it down to one group
+        std::size_t g = std::partition_point(values_.begin(), values_.end(), before) - values_.begin();
+        if( g == 0 ) return 0;
+        std::uint32_t group[pack_group];
+        decode_group(g - 1, group);
+        std::size_t first = (g - 1) * pack_group, end = std::min(size_, g * pack_group);
+        for(std::size_t i = first + 1; i < end; ++i){
+          if( !before(static_cast<int>(group[i - first])) ) return i;
+        }
+        return end;
+      }
+      default: break;
+    }
+    std::size_t lo = 0, hi = size_;
+    while( lo < hi ){
+      std::size_t mid = lo + (hi - lo) / 2;
+      if( before((*this)[mid]) ) lo = mid + 1;
+      else hi = mid;
+    }
+    return lo;
+  }
+
+  /*
+  Replaces the plain values by the smallest encoding. Null rows (validity bit clear) take the
+  value of the row before them, so they neither break runs nor widen the frame.
+  */
+  void compress(std::uint64_t const* validity){
+    using namespace compress_detail;
+    if( encoding_ != int_plain || values_.empty() ) return;
+
+    std::size_t n = values_.size();
+    std::vector<int> v(values_.begin(), values_.end());
+    if( validity ){
+      bool seen = false;
+      for(std::size_t i = 0; i < n; ++i){
+        bool valid = (validity[i >> 6] >> (i & 63)) & 1;
+        if( valid && !seen ){
+          std::fill(v.begin(), v.begin() + i, v[i]);
+          seen = true;
+        }else if( !valid && seen ){
+          v[i] = v[i - 1];
+        }
+      }
+    }
+
+    std::size_t runs = 1;
+    int lo = v[0], hi = v[0];
+    std::int64_t dlo = 0, dhi = 0;
+    bool first_delta = true;
+    for(std::size_t i = 1; i < n; ++i){
+      runs += v[i] != v[i - 1];
+      lo = std::min(lo, v[i]);
+      hi = std::max(hi, v[i]);
+      if( i % pack_group == 0 ) continue;
+      std::int64_t d = static_cast<std::int64_t>(v[i]) - v[i - 1];
+      dlo = first_delta ? d : std::min(dlo, d);
+      dhi = first_delta ? d : std::max(dhi, d);
+      first_delta = false;
+    }
+
+    std::size_t groups = (n + pack_group - 1) / pack_group;
+    unsigned for_bits = bit_width(static_cast<std::uint64_t>(static_cast<std::int64_t>(hi) - lo));
+    unsigned delta_bits = bit_width(static_cast<std::uint64_t>(dhi - dlo));
+    bool delta_fits = delta_bits <= 32 && dlo >= std::numeric_limits<int>::min() && dlo <= std::numeric_limits<int>::max();
+
+    std::size_t best = n * sizeof(int);
+    int_encoding pick = int_plain;
+    std::size_t for_bytes = packed_words(n, for_bits) * 4;
+    std::size_t delta_bytes = packed_words(n, delta_bits) * 4 + groups * sizeof(int);
+    std::size_t rle_bytes = runs * (sizeof(int) + sizeof(std::uint32_t));
+    if( for_bytes < best ){ best = for_bytes; pick = int_for; }
+    if( delta_fits && delta_bytes < best ){ best = delta_bytes; pick = int_delta; }
+    if( rle_bytes < best ){ best = rle_bytes; pick = int_rle; }
+    if( pick == int_plain ) return;
+
+    int_column c;
+    c.encoding_ = pick;
+    c.size_ = n;
+    std::vector<std::uint32_t> codes(n, 0);
+    switch( pick ){
+      case int_rle:
+        for(std::size_t i = 1; i <= n; ++i){
+          if( i < n && v[i] == v[i - 1] ) continue;
+          c.values_.push_back(v[i - 1]);
+          c.ends_.push_back(static_cast<std::uint32_t>(i));
+        }
+        break;
+      case int_for:
+        c.bits_ = for_bits;
+        c.base_ = lo;
+        for(std::size_t i = 0; i < n; ++i){ codes[i] = static_cast<std::uint32_t>(v[i]) - static_cast<std::uint32_t>(lo); }
+        pack(codes.data(), n, c.bits_, c.words_);
+        break;
+      default:
+        c.bits_ = delta_bits;
+        c.base_ = static_cast<int>(dlo);
+        for(std::size_t i = 0; i < n; ++i){
+          if( i % pack_group == 0 ){
+            c.values_.push_back(v[i]);
+            continue;
+          }
+          codes[i] = static_cast<std::uint32_t>(v[i]) - static_cast<std::uint32_t>(v[i - 1]) - static_cast<std::uint32_t>(c.base_);
+        }
+        pack(codes.data(), n, c.bits_, c.words_);
+        break;
+    }
+    *this = std::move(c);
+  }
+
+private:
+  //the 128 values of group g of a for or delta column (past the last row: garbage)
+  void decode_group(std::size_t g, std::uint32_t* out) const {
+    compress_detail::unpack_group(words_.data(), bits_, g, out);
+    std::uint32_t base = static_cast<std::uint32_t>(base_);
+    if( encoding_ == int_for ){
+      for(std::size_t i = 0; i < pack_group; ++i){ out[i] += base; }
+      return;
+    }
+    out[0] = static_cast<std::uint32_t>(values_[g]);
+    for(std::size_t i = 1; i < pack_group; ++i){ out[i] += out[i - 1] + base; }
+  }
+};
+
+#endif
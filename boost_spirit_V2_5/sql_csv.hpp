@@ -0,0 +1,294 @@
+#ifndef SQL_CSV_HPP
+#define SQL_CSV_HPP
+
+#include "sql_parallel.hpp"
+#include "sql_swar.hpp"
+#include "sql_table.hpp"
+
+#include <boost/utility/string_ref.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*
+CSV / TSV loading straight into columnar blocks.
+
+The input is cut into chunks that are parsed in parallel:
+  1. every chunk counts its quotes; the parity of the quotes before a chunk tells whether the
+     chunk starts inside a quoted field
+  2. with that state known, every chunk's first record starts after its first newline outside
+     quotes, so the chunks are moved to record boundaries
+  3. every chunk is parsed into its own blocks, which are then appended in chunk order
+
+Parsing finds the structural characters 64 bytes at a time: SSE2 compares give one bitmask each
+for quotes, delimiters and newlines, a prefix xor of the quote mask gives the bytes inside quotes,
+and the delimiters and newlines outside quotes are walked bit by bit. Ints are parsed with SWAR
+(sql_swar.hpp).
+
+Fields follow RFC 4180: quoted fields may hold delimiters, newlines and doubled quotes; \r\n line
+ends are accepted. The first line holds the column names (header_), a column is an int column
+when every non empty value of the first csv_sample_rows records is an int; empty fields are null.
+An int column meeting a value that is no int further down becomes a string column, and the records
+are parsed once more. An empty line is no record, except in a file of one column where it is a
+null.
+*/
+
+struct csv_options{
+  char delimiter_ = ',';
+  bool header_ = true;
+};
+
+const std::size_t csv_sample_rows = 1000;
+const std::size_t csv_chunk_bytes = 8 * 1024 * 1024;
+
+namespace csv_detail{
+
+  //bit i set = byte i of the 64 is c
+  inline std::uint64_t byte_mask(char const* p, char c){
+#if defined(__SSE2__)
+    __m128i m = _mm_set1_epi8(c);
+    std::uint64_t r = 0;
+    for(int k = 0; k < 4; ++k){
+      __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p + 16 * k));
+      r |= std::uint64_t(static_cast<std::uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, m)))) << (16 * k);
+    }
+    return r;
+#else
+    std::uint64_t r = 0;
+    for(int i = 0; i < 64; ++i){ r |= std::uint64_t(p[i] == c) << i; }
+    return r;
+#endif
+  }
+
+  //bit i = xor of bits 0..i: set from an opening quote up to, not including, the closing one
+  inline std::uint64_t prefix_xor(std::uint64_t x){
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+  }
+
+  inline std::size_t count_quotes(char const* p, std::size_t n){
+    std::size_t count = 0, i = 0;
+    for(; i + 64 <= n; i += 64){ count += __builtin_popcountll(byte_mask(p + i, '"')); }
+    for(; i < n; ++i){ count += p[i] == '"'; }
+    return count;
+  }
+
+  /*
+  Calls field(begin, end, last) for every field of the records in [begin, end), last set for the
+  last field of a record; the quote state at begin is "outside". Text ending after a delimiter
+  ends with an empty last field.
+  */
+  template<typename Field>
+  void split(char const* data, std::size_t begin, std::size_t end, char delimiter, Field field){
+    std::size_t start = begin;
+    bool open = false;   //the last structural char was a delimiter: a field follows it
+    std::uint64_t inside = 0;
+    char tail[64];
+    for(std::size_t block = begin; block < end; block += 64){
+      char const* p = data + block;
+      std::size_t len = std::min<std::size_t>(64, end - block);
+      if( len < 64 ){
+        std::memset(tail, 0, sizeof(tail));
+        std::memcpy(tail, p, len);
+        p = tail;
+      }
+      std::uint64_t quoted = prefix_xor(byte_mask(p, '"')) ^ inside;
+      inside = (quoted >> 63) ? ~std::uint64_t(0) : 0;
+      std::uint64_t newlines = byte_mask(p, '\n') & ~quoted;
+      std::uint64_t structural = (byte_mask(p, delimiter) | newlines) & ~quoted;
+      if( len < 64 ) structural &= (std::uint64_t(1) << len) - 1;
+      for(; structural; structural &= structural - 1){
+        unsigned bit = __builtin_ctzll(structural);
+        std::size_t pos = block + bit;
+        open = ((newlines >> bit) & 1) == 0;
+        field(start, pos, !open);
+        start = pos + 1;
+      }
+    }
+    if( start < end || open ) field(start, end, true);
+  }
+
+  //the value of a field: \r of a \r\n line end dropped, quotes removed, doubled quotes undone
+  inline boost::string_ref unquote(char const* data, std::size_t begin, std::size_t end, bool last, std::string& buffer){
+    if( last && end > begin && data[end - 1] == '\r' ) --end;
+    if( end - begin < 2 || data[begin] != '"' || data[end - 1] != '"' ) return boost::string_ref(data + begin, end - begin);
+    ++begin;
+    --end;
+    if( std::find(data + begin, data + end, '"') == data + end ) return boost::string_ref(data + begin, end - begin);
+    buffer.clear();
+    for(std::size_t i = begin; i < end; ++i){
+      buffer.push_back(data[i]);
+      if( data[i] == '"' && i + 1 < end && data[i + 1] == '"' ) ++i;
+    }
+    return boost::string_ref(buffer);
+  }
+
+  //position after the first newline outside quotes at or after pos
+  inline std::size_t next_record(char const* data, std::size_t size, std::size_t pos, bool inside){
+    for(; pos < size; ++pos){
+      if( data[pos] == '"' ) inside = !inside;
+      else if( data[pos] == '\n' && !inside ) return pos + 1;
+    }
+    return size;
+  }
+}
+
+//parses csv text held in memory
+inline table_data parse_csv(char const* data, std::size_t size, csv_options const& options = csv_options()){
+  using namespace csv_detail;
+  char delimiter = options.delimiter_;
+  std::string buffer;
+
+  //the header, then the column kinds from a sample of the records
+  std::size_t body = options.header_ ? next_record(data, size, 0, false) : 0;
+  std::vector<std::string> header;
+  split(data, 0, body, delimiter, [&](std::size_t b, std::size_t e, bool last){
+    header.push_back(unquote(data, b, e, last, buffer).to_string());
+  });
+
+  std::size_t sample_end = body;
+  for(std::size_t r = 0; r < csv_sample_rows && sample_end < size; ++r){ sample_end = next_record(data, size, sample_end, false); }
+  std::vector<int> ints, seen;
+  std::size_t column = 0;
+  split(data, body, sample_end, delimiter, [&](std::size_t b, std::size_t e, bool last){
+    boost::string_ref s = unquote(data, b, e, last, buffer);
+    if( column >= ints.size() ){
+      ints.push_back(1);
+      seen.push_back(0);
+    }
+    int v;
+    if( !s.empty() ){
+      seen[column] = 1;
+      if( !swar_parse_int(s.data(), s.size(), v) ) ints[column] = 0;
+    }
+    column = last ? 0 : column + 1;
+  });
+
+  table_data table;
+  std::size_t columns = std::max(header.size(), ints.size());
+  for(std::size_t c = 0; c < columns; ++c){
+    table.schema_.names_.push_back(c < header.size() && !header[c].empty() ? header[c] : "c" + std::to_string(c));
+    table.schema_.kinds_.push_back(c < ints.size() && ints[c] && seen[c] ? col_int : col_string);
+  }
+  if( columns == 0 ) return table;
+
+  //1. quotes per chunk
+  std::size_t chunks = (size - body + csv_chunk_bytes - 1) / csv_chunk_bytes;
+  std::vector<std::size_t> starts(chunks + 1, size), quotes(chunks, 0);
+  auto chunk_begin = [&](std::size_t i){ return body + i * csv_chunk_bytes; };
+  unsigned workers = workers_for(chunks);
+  run_morsels(workers, chunks, [&](unsigned, std::size_t i){
+    quotes[i] = count_quotes(data + chunk_begin(i), std::min(csv_chunk_bytes, size - chunk_begin(i)));
+    return true;
+  });
+
+  //2. record boundaries
+  std::vector<char> inside(chunks, 0);
+  for(std::size_t i = 1; i < chunks; ++i){ inside[i] = inside[i - 1] ^ (quotes[i - 1] & 1); }
+  run_morsels(workers, chunks, [&](unsigned, std::size_t i){
+    starts[i] = (i == 0) ? body : next_record(data, size, chunk_begin(i), inside[i] != 0);
+    return true;
+  });
+  for(std::size_t i = 1; i <= chunks; ++i){ starts[i] = std::max(starts[i], starts[i - 1]); }
+
+  //3. records, until the kinds hold for all of them: the int columns found holding other values
+  //become string columns and every chunk is parsed again
+  std::vector<table_data> parts;
+  std::vector<std::string> errors;
+  std::unique_ptr<std::atomic<bool>[]> not_int(new std::atomic<bool>[columns]);
+  for(bool again = true; again; ){
+    for(std::size_t c = 0; c < columns; ++c){ not_int[c] = false; }
+    parts.clear();
+    parts.resize(chunks);
+    errors.assign(chunks, std::string());
+    run_morsels(workers, chunks, [&](unsigned, std::size_t i){
+      parts[i].schema_ = table.schema_;
+      std::string unquoted;
+      try{
+        table_builder builder(parts[i]);
+        std::size_t column = 0;
+        split(data, starts[i], starts[i + 1], delimiter, [&](std::size_t b, std::size_t e, bool last){
+          //an empty line is no record, but the null of a one column file
+          if( columns > 1 && last && column == 0 && (e == b || (e == b + 1 && data[b] == '\r')) ) return;
+          if( column >= columns ) throw std::runtime_error("a record has more than " + std::to_string(columns) + " fields");
+          boost::string_ref s = unquote(data, b, e, last, unquoted);
+          int v;
+          if( s.empty() ) builder.put_null(column);
+          else if( table.schema_.kinds_[column] == col_string ) builder.put(column, s);
+          else if( swar_parse_int(s.data(), s.size(), v) ) builder.put(column, v);
+          else{
+            //this parse is thrown away, the rest of the chunk still looks for other such columns
+            not_int[column] = true;
+            builder.put_null(column);
+          }
+          ++column;
+          if( !last ) return;
+          for(; column < columns; ++column){ builder.put_null(column); }
+          builder.end_row();
+          column = 0;
+        });
+        builder.finish();
+      }catch(std::exception const& e){
+        errors[i] = e.what();
+        return false;
+      }
+      return true;
+    });
+    for(auto& e : errors){
+      if( !e.empty() ) throw std::runtime_error(e);
+    }
+    again = false;
+    for(std::size_t c = 0; c < columns; ++c){
+      if( !not_int[c] ) continue;
+      table.schema_.kinds_[c] = col_string;
+      again = true;
+    }
+  }
+
+  for(auto& part : parts){ table.blocks_.insert(table.blocks_.end(), part.blocks_.begin(), part.blocks_.end()); }
+  return table;
+}
+
+//maps a csv file and parses it; the table owns its data, the mapping is gone afterwards
+inline table_data load_csv(std::string const& path, csv_options const& options = csv_options()){
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if( fd < 0 ) throw std::runtime_error("can not open " + path);
+  struct stat st;
+  if( ::fstat(fd, &st) != 0 ){
+    ::close(fd);
+    throw std::runtime_error("can not read " + path);
+  }
+  std::size_t size = static_cast<std::size_t>(st.st_size);
+  if( size == 0 ){
+    ::close(fd);
+    return parse_csv("", 0, options);
+  }
+  void* addr = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if( addr == MAP_FAILED ) throw std::runtime_error("can not map " + path);
+  std::shared_ptr<void> mapping(addr, [size](void* p){ ::munmap(p, size); });
+  ::madvise(addr, size, MADV_SEQUENTIAL);
+  return parse_csv(static_cast<char const*>(addr), size, options);
+}
+
+#endif
@@ -0,0 +1,160 @@
+#ifndef SQL_EPOCH_HPP
+#define SQL_EPOCH_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+/*
+Epoch based reclamation, for values read without locks while writers replace them.
+
+A reader pins the current epoch for as long as it dereferences a published pointer (epoch_guard);
+a writer swaps the pointer, advances the epoch and retires the old value tagged with the epoch it
+was replaced in. A retired value is deleted once every pinned reader pinned a later epoch: those
+readers loaded the pointer after the swap, so nobody can still hold the old one.
+
+Pinning is two atomic stores on a record of the thread's own, found once per thread in a lock free
+list; records of finished threads are reused. Writers serialize among themselves on the retired
+list only.
+
+published<T> wraps the pattern for one value: load() copies the value under a guard, store()
+swaps a new one in. With T a shared_ptr the reader leaves with its own reference after a single
+atomic increment, so it can keep the value for as long as it likes without holding an epoch back.
+*/
+
+class epoch_domain{
+public:
+  epoch_domain() : epoch_(1), records_(nullptr) {}
+
+  //the records are left alone: a detached thread may still give its record back at exit
+  ~epoch_domain(){
+    for(auto& r : retired_){ r.second(); }
+  }
+
+  epoch_domain(epoch_domain const&) = delete;
+  epoch_domain& operator=(epoch_domain const&) = delete;
+
+  //pins the current epoch for the calling thread, pins nest
+  void pin(){
+    local& l = mine();
+    if( l.depth_++ == 0 ) l.record_->pinned_.store(epoch_.load());
+  }
+
+  void unpin(){
+    local& l = mine();
+    if( --l.depth_ == 0 ) l.record_->pinned_.store(idle);
+  }
+
+  //deleter() runs once no reader can reach what it deletes any more; call it after the swap
+  void retire(std::function<void()> deleter){
+    std::uint64_t replaced = epoch_.fetch_add(1);
+    std::vector<std::function<void()>> ready;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      retired_.emplace_back(replaced, std::move(deleter));
+      std::uint64_t oldest = oldest_pinned();
+      auto kept = std::partition(retired_.begin(), retired_.end(), [&](retired const& r){ return r.first >= oldest; });
+      for(auto it = kept; it != retired_.end(); ++it){ ready.push_back(std::move(it->second)); }
+      retired_.erase(kept, retired_.end());
+    }
+    for(auto& d : ready){ d(); }
+  }
+
+  //retired values waiting for readers
+  std::size_t pending() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return retired_.size();
+  }
+
+private:
+  static const std::uint64_t idle = std::numeric_limits<std::uint64_t>::max();
+
+  struct record{
+    std::atomic<std::uint64_t> pinned_{idle};
+    std::atomic<bool> used_{true};
+    record* next_ = nullptr;
+  };
+
+  //the record of the calling thread, given back when the thread ends
+  struct local{
+    explicit local(epoch_domain& domain) : record_(domain.acquire()), depth_(0) {}
+    ~local(){ record_->used_.store(false); }
+
+    record* record_;
+    unsigned depth_;
+  };
+
+  local& mine(){
+    thread_local local l(*this);
+    return l;
+  }
+
+  record* acquire(){
+    for(record* r = records_.load(); r; r = r->next_){
+      bool used = false;
+      if( !r->used_.load() && r->used_.compare_exchange_strong(used, true) ) return r;
+    }
+    record* r = new record();
+    r->next_ = records_.load();
+    while( !records_.compare_exchange_weak(r->next_, r) ){}
+    return r;
+  }
+
+  std::uint64_t oldest_pinned() const {
+    std::uint64_t oldest = idle;
+    for(record* r = records_.load(); r; r = r->next_){ oldest = std::min(oldest, r->pinned_.load()); }
+    return oldest;
+  }
+
+  using retired = std::pair<std::uint64_t, std::function<void()>>;
+
+  std::atomic<std::uint64_t> epoch_;
+  std::atomic<record*> records_;
+  std::vector<retired> retired_;
+  mutable std::mutex mutex_;
+};
+
+//one domain for the process: mine() keeps a record per thread, not per domain and thread
+inline epoch_domain& epochs(){
+  static epoch_domain domain;
+  return domain;
+}
+
+class epoch_guard{
+public:
+  epoch_guard(){ epochs().pin(); }
+  ~epoch_guard(){ epochs().unpin(); }
+
+  epoch_guard(epoch_guard const&) = delete;
+  epoch_guard& operator=(epoch_guard const&) = delete;
+};
+
+template<typename T>
+class published{
+public:
+  explicit published(T value) : current_(new T(std::move(value))) {}
+  ~published(){ delete current_.load(); }
+
+  published(published const&) = delete;
+  published& operator=(published const&) = delete;
+
+  T load() const {
+    epoch_guard guard;
+    return *current_.load();
+  }
+
+  void store(T value){
+    T* old = current_.exchange(new T(std::move(value)));
+    epochs().retire([old]{ delete old; });
+  }
+
+private:
+  std::atomic<T*> current_;
+};
+
+#endif
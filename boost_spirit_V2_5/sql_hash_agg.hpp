@@ -0,0 +1,144 @@
+#ifndef SQL_HASH_AGG_HPP
+#define SQL_HASH_AGG_HPP
+
+#include <boost/utility/string_ref.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/*
+Hash aggregation support: group keys are serialized to bytes and mapped to dense group ids
+(0, 1, 2, ...) by an open addressing table, the aggregate states live in plain arrays indexed
+by group id. Each worker owns one table, the partial tables are merged at the end.
+*/
+
+inline std::uint64_t hash_bytes(char const* p, std::size_t n){
+  const std::uint64_t m = 0xff51afd7ed558ccdull;
+  std::uint64_t h = 0x9e3779b97f4a7c15ull ^ n;
+  for(; n >= 8; p += 8, n -= 8){
+    std::uint64_t w;
+    std::memcpy(&w, p, 8);
+    h = (h ^ w) * m;
+    h ^= h >> 32;
+  }
+  if( n ){
+    std::uint64_t w = 0;
+    std::memcpy(&w, p, n);
+    h = (h ^ w) * m;
+  }
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ull;
+  return h ^ (h >> 33);
+}
+
+inline std::uint64_t hash_bytes(boost::string_ref s){ return hash_bytes(s.data(), s.size()); }
+
+//murmur3 finalizer, for single int values
+inline std::uint64_t hash_int(std::uint64_t x){
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdull;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ull;
+  return x ^ (x >> 33);
+}
+
+//a batch of serialized keys: key i is bytes_[offsets_[i], offsets_[i+1])
+struct key_batch{
+  std::string bytes_;
+  std::vector<std::uint32_t> offsets_ = std::vector<std::uint32_t>(1, 0);
+
+  std::size_t size() const { return offsets_.size() - 1; }
+
+  boost::string_ref key(std::size_t i) const {
+    return boost::string_ref(bytes_.data() + offsets_[i], offsets_[i + 1] - offsets_[i]);
+  }
+
+  void clear(){
+    bytes_.clear();
+    offsets_.resize(1);
+  }
+
+  //the bytes appended since the previous end_key() form the next key
+  void end_key(){ offsets_.push_back(static_cast<std::uint32_t>(bytes_.size())); }
+};
+
+/*
+Linear probing over 8 byte slots (32 bit hash tag + group id), so one cache line holds 8 probes;
+the keys themselves live in a separate arena and are only compared when the tags match.
+find_or_insert on a batch first hashes every key and prefetches its home slot, then probes:
+the cache misses of the batch overlap instead of being paid one after another.
+*/
+class group_table{
+public:
+  group_table() : slots_(1024, slot{0, empty}), mask_(1023) {}
+
+  std::size_t size() const { return hashes_.size(); }
+
+  std::uint64_t hash(std::uint32_t group) const { return hashes_[group]; }
+
+  boost::string_ref key(std::uint32_t group) const {
+    return boost::string_ref(arena_.data() + key_offsets_[group], key_offsets_[group + 1] - key_offsets_[group]);
+  }
+
+  void find_or_insert(key_batch const& keys, std::uint32_t* groups){
+    std::size_t n = keys.size();
+    batch_hashes_.resize(n);
+    for(std::size_t i = 0; i < n; ++i){
+      batch_hashes_[i] = hash_bytes(keys.key(i));
+#if defined(__GNUC__)
+      __builtin_prefetch(&slots_[batch_hashes_[i] & mask_]);
+#endif
+    }
+    for(std::size_t i = 0; i < n; ++i){ groups[i] = find_or_insert(keys.key(i), batch_hashes_[i]); }
+  }
+
+  std::uint32_t find_or_insert(boost::string_ref key, std::uint64_t h){
+    if( 2 * (size() + 1) > slots_.size() ) grow();
+
+    std::uint32_t tag = static_cast<std::uint32_t>(h >> 32);
+    for(std::size_t i = h & mask_;; i = (i + 1) & mask_){
+      slot& s = slots_[i];
+      if( s.group_ == empty ){
+        s.tag_ = tag;
+        s.group_ = static_cast<std::uint32_t>(size());
+        hashes_.push_back(h);
+        arena_.append(key.data(), key.size());
+        key_offsets_.push_back(static_cast<std::uint32_t>(arena_.size()));
+        return s.group_;
+      }
+      if( s.tag_ == tag && this->key(s.group_) == key ) return s.group_;
+    }
+  }
+
+private:
+  static const std::uint32_t empty = 0xffffffffu;
+
+  struct slot{
+    std::uint32_t tag_;
+    std::uint32_t group_;
+  };
+
+  //the full hashes are kept per group, growing never rehashes a key
+  void grow(){
+    std::vector<slot> slots(slots_.size() * 2, slot{0, empty});
+    std::size_t mask = slots.size() - 1;
+    for(std::uint32_t g = 0; g < size(); ++g){
+      std::size_t i = hashes_[g] & mask;
+      while( slots[i].group_ != empty ){ i = (i + 1) & mask; }
+      slots[i] = slot{static_cast<std::uint32_t>(hashes_[g] >> 32), g};
+    }
+    slots_.swap(slots);
+    mask_ = mask;
+  }
+
+  std::vector<slot> slots_;
+  std::size_t mask_;
+  std::vector<std::uint64_t> hashes_;
+  std::string arena_;
+  std::vector<std::uint32_t> key_offsets_ = std::vector<std::uint32_t>(1, 0);
+  std::vector<std::uint64_t> batch_hashes_;
+};
+
+#endif
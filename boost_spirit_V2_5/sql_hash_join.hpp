@@ -0,0 +1,159 @@
+#ifndef SQL_HASH_JOIN_HPP
+#define SQL_HASH_JOIN_HPP
+
+#include "sql_parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/*
+Radix partitioned hash join.
+
+Both inputs are (hash, row) tuples. They are scattered into 2^bits partitions on the top hash bits,
+with bits picked so that one build partition plus its bucket array stays within join_partition_bytes
+(about an L2 cache). Then the workers take partitions one at a time: build a chained hash table over
+the build partition, probe it with the matching probe partition, both while it is still in cache.
+
+The optional bloom filter is a semi-join prefilter: it is filled with the build hashes and probe
+tuples that certainly have no partner are dropped before they are even partitioned.
+*/
+
+struct join_tuple{
+  std::uint64_t hash_;
+  std::uint32_t row_;
+};
+
+const std::size_t join_partition_bytes = 256 * 1024;
+
+//blocked bloom filter: every key sets 3 bits of a single 64 bit word, so a lookup is one cache miss
+class bloom_filter{
+public:
+  explicit bloom_filter(std::size_t keys) : words_(word_count(keys)), mask_(words_.size() - 1) {
+    for(auto& w : words_){ w.store(0, std::memory_order_relaxed); }
+  }
+
+  void add(std::uint64_t h){ words_[h & mask_].fetch_or(bits(h), std::memory_order_relaxed); }
+
+  bool may_contain(std::uint64_t h) const {
+    std::uint64_t b = bits(h);
+    return (words_[h & mask_].load(std::memory_order_relaxed) & b) == b;
+  }
+
+private:
+  //about 16 bits per key, rounded to a power of two
+  static std::size_t word_count(std::size_t keys){
+    std::size_t n = 1;
+    while( n * 4 < keys ){ n *= 2; }
+    return n;
+  }
+
+  static std::uint64_t bits(std::uint64_t h){
+    return (std::uint64_t(1) << ((h >> 40) & 63)) | (std::uint64_t(1) << ((h >> 46) & 63)) | (std::uint64_t(1) << ((h >> 52) & 63));
+  }
+
+  std::vector<std::atomic<std::uint64_t>> words_;
+  std::size_t mask_;
+};
+
+inline unsigned partition_bits(std::size_t build_tuples){
+  unsigned bits = 0;
+  while( bits < 14 && (build_tuples >> bits) * 2 * sizeof(join_tuple) > join_partition_bytes ){ ++bits; }
+  return bits;
+}
+
+//parallel scatter on the top bits of the hash; bounds[p]..bounds[p+1] is partition p of the result
+inline std::vector<join_tuple> radix_partition(std::vector<join_tuple> const& in, unsigned bits, std::vector<std::size_t>& bounds){
+  std::size_t parts = std::size_t(1) << bits;
+  std::size_t n = in.size();
+  unsigned workers = workers_for(n / 4096);
+  std::vector<std::vector<std::size_t>> counts(workers, std::vector<std::size_t>(parts, 0));
+
+  auto part_of = [&](join_tuple const& t){ return bits ? static_cast<std::size_t>(t.hash_ >> (64 - bits)) : 0; };
+
+  run_workers(workers, [&](unsigned w){
+    for(std::size_t i = n * w / workers; i < n * (w + 1) / workers; ++i){
+      if( query_stopped_at(i) ) return;
+      ++counts[w][part_of(in[i])];
+    }
+  });
+
+  bounds.assign(parts + 1, 0);
+  std::size_t offset = 0;
+  for(std::size_t p = 0; p < parts; ++p){
+    bounds[p] = offset;
+    for(unsigned w = 0; w < workers; ++w){
+      std::size_t c = counts[w][p];
+      counts[w][p] = offset;
+      offset += c;
+    }
+  }
+  bounds[parts] = offset;
+
+  std::vector<join_tuple> out(n);
+  run_workers(workers, [&](unsigned w){
+    std::vector<std::size_t>& pos = counts[w];
+    for(std::size_t i = n * w / workers; i < n * (w + 1) / workers; ++i){
+      if( query_stopped_at(i) ) return;
+      out[pos[part_of(in[i])]++] = in[i];
+    }
+  });
+  return out;
+}
+
+//(probe row, build row) of every pair with equal hashes for which equal(probe row, build row) holds
+template<typename Equal>
+std::vector<std::pair<std::uint32_t, std::uint32_t>> hash_join(std::vector<join_tuple> const& build, std::vector<join_tuple> probe,
+                                                              Equal equal, bool use_bloom){
+  if( use_bloom ){
+    bloom_filter bloom(build.size());
+    unsigned workers = workers_for(build.size() / 4096);
+    run_workers(workers, [&](unsigned w){
+      for(std::size_t i = build.size() * w / workers; i < build.size() * (w + 1) / workers; ++i){ bloom.add(build[i].hash_); }
+    });
+    probe.erase(std::remove_if(probe.begin(), probe.end(), [&](join_tuple const& t){ return !bloom.may_contain(t.hash_); }), probe.end());
+  }
+
+  unsigned bits = partition_bits(build.size());
+  std::vector<std::size_t> build_bounds, probe_bounds;
+  std::vector<join_tuple> build_parts = radix_partition(build, bits, build_bounds);
+  std::vector<join_tuple> probe_parts = radix_partition(probe, bits, probe_bounds);
+
+  std::size_t parts = std::size_t(1) << bits;
+  unsigned workers = workers_for(parts);
+  std::vector<std::vector<std::pair<std::uint32_t, std::uint32_t>>> results(workers);
+
+  run_morsels(workers, parts, [&](unsigned w, std::size_t p){
+    std::size_t lo = build_bounds[p], hi = build_bounds[p + 1];
+    if( lo == hi || probe_bounds[p] == probe_bounds[p + 1] ) return true;
+
+    //bucket chains: head[bucket] -> first tuple, next[tuple] -> following tuple of the bucket
+    const std::uint32_t end = 0xffffffffu;
+    std::size_t buckets = 1;
+    while( buckets < hi - lo ){ buckets *= 2; }
+    std::vector<std::uint32_t> head(buckets, end), next(hi - lo);
+    for(std::size_t i = lo; i < hi; ++i){
+      std::size_t b = build_parts[i].hash_ & (buckets - 1);
+      next[i - lo] = head[b];
+      head[b] = static_cast<std::uint32_t>(i - lo);
+    }
+
+    for(std::size_t i = probe_bounds[p]; i < probe_bounds[p + 1]; ++i){
+      if( query_stopped_at(i) ) return true;
+      join_tuple const& t = probe_parts[i];
+      for(std::uint32_t j = head[t.hash_ & (buckets - 1)]; j != end; j = next[j]){
+        join_tuple const& b = build_parts[lo + j];
+        if( b.hash_ == t.hash_ && equal(t.row_, b.row_) ) results[w].emplace_back(t.row_, b.row_);
+      }
+    }
+    return true;
+  });
+
+  std::vector<std::pair<std::uint32_t, std::uint32_t>> pairs;
+  for(auto& r : results){ pairs.insert(pairs.end(), r.begin(), r.end()); }
+  return pairs;
+}
+
+#endif
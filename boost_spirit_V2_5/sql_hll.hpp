@@ -0,0 +1,107 @@
+#ifndef SQL_HLL_HPP
+#define SQL_HLL_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*
+HyperLogLog sketch for APPROX_COUNT_DISTINCT.
+
+m = 2^14 one byte registers, 16 KB per sketch whatever the input size. The top 14 bits of a 64 bit
+hash select the register, the register keeps the max of (leading zeros of the remaining bits + 1).
+
+Error bound: the relative standard error is 1.04 / sqrt(m) = 0.81%, so about 68% of the estimates
+are within 0.81% of the true count, 95% within 1.6% and 99.7% within 2.4%. Small cardinalities
+(estimate <= 2.5 m with empty registers left) use linear counting, which is nearly exact there.
+With 64 bit hashes no large range correction is needed.
+
+Sketches are mergeable: the register-wise max of two sketches is the sketch of the union, so every
+worker fills its own sketch and they are merged at the end (16 bytes per instruction with SSE2).
+*/
+
+const unsigned hll_precision = 14;
+const std::size_t hll_registers = std::size_t(1) << hll_precision;
+
+class hll_sketch{
+public:
+  hll_sketch() : registers_(hll_registers, 0) {}
+
+  void add_hash(std::uint64_t h){
+    std::uint8_t& reg = registers_[h >> (64 - hll_precision)];
+    std::uint8_t r = rank(h);
+    if( r > reg ) reg = r;
+  }
+
+  //batched update: indices and ranks are computed in one branch free loop, then the registers
+  //are updated in a second one
+  void add_hashes(std::uint64_t const* hashes, std::size_t n){
+    const std::size_t batch = 256;
+    std::uint16_t idx[batch];
+    std::uint8_t ranks[batch];
+    for(std::size_t start = 0; start < n; start += batch){
+      std::size_t len = (n - start < batch) ? n - start : batch;
+      for(std::size_t i = 0; i < len; ++i){
+        std::uint64_t h = hashes[start + i];
+        idx[i] = static_cast<std::uint16_t>(h >> (64 - hll_precision));
+        ranks[i] = rank(h);
+      }
+      for(std::size_t i = 0; i < len; ++i){
+        std::uint8_t& reg = registers_[idx[i]];
+        reg = ranks[i] > reg ? ranks[i] : reg;
+      }
+    }
+  }
+
+  void merge(hll_sketch const& other){
+    std::uint8_t* a = registers_.data();
+    std::uint8_t const* b = other.registers_.data();
+#if defined(__SSE2__)
+    for(std::size_t i = 0; i < hll_registers; i += 16){
+      __m128i x = _mm_loadu_si128(reinterpret_cast<__m128i const*>(a + i));
+      __m128i y = _mm_loadu_si128(reinterpret_cast<__m128i const*>(b + i));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(a + i), _mm_max_epu8(x, y));
+    }
+#else
+    for(std::size_t i = 0; i < hll_registers; ++i){ a[i] = b[i] > a[i] ? b[i] : a[i]; }
+#endif
+  }
+
+  double estimate() const {
+    const double m = static_cast<double>(hll_registers);
+    const double alpha = 0.7213 / (1.0 + 1.079 / m);
+
+    static const std::vector<double> inverse_powers = []{
+      std::vector<double> p(65);
+      for(int r = 0; r < 65; ++r){ p[r] = std::ldexp(1.0, -r); }
+      return p;
+    }();
+
+    double sum = 0;
+    std::size_t zeros = 0;
+    for(auto r : registers_){
+      sum += inverse_powers[r];
+      zeros += (r == 0);
+    }
+    double e = alpha * m * m / sum;
+    if( e <= 2.5 * m && zeros ) return m * std::log(m / static_cast<double>(zeros));
+    return e;
+  }
+
+  std::size_t bytes() const { return registers_.size(); }
+
+private:
+  //the sentinel bit keeps the rank <= 64 - precision + 1 for an all zero remainder
+  static std::uint8_t rank(std::uint64_t h){
+    std::uint64_t w = (h << hll_precision) | (std::uint64_t(1) << (hll_precision - 1));
+    return static_cast<std::uint8_t>(__builtin_clzll(w) + 1);
+  }
+
+  std::vector<std::uint8_t> registers_;
+};
+
+#endif
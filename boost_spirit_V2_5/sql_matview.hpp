@@ -0,0 +1,99 @@
+#ifndef SQL_MATVIEW_HPP
+#define SQL_MATVIEW_HPP
+
+#include "sql_parallel.hpp"
+#include "sql_table.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/*
+Incrementally maintained materialized views: SELECT columns FROM t WHERE conditions.
+
+Blocks are immutable, so a write to a table shows up as new blocks (inserts), as blocks replaced
+by new ones (updates) or as small blocks merged into a big one (see sql_store.hpp). The view keeps
+its rows per block together with the block they came from; a refresh looks the blocks of the table
+up among the ones it saw last and evaluates the conditions on the blocks it has not seen only,
+every other block keeps its rows as they are.
+Reading the view concatenates the per block rows: the cost is the size of the result, not of the
+table.
+
+The new blocks are evaluated without the lock (the workers may yield to the scheduler, see
+sql_scheduler.hpp, and a reader of the view must not wait for a parked refresh); the result is
+swapped in under the lock unless a refresh to the same or a later version of the table got there
+first. Two refreshes of the same version may both evaluate the new blocks, one of them is kept.
+
+Row is the type of one result row, compute(block, rows) appends the result rows of a block.
+*/
+
+template<typename Row>
+class materialized_view{
+public:
+  using compute_fn = std::function<void(table_block const&, std::vector<Row>&)>;
+
+  explicit materialized_view(compute_fn compute) : compute_(compute), version_(0) {}
+
+  //brings the view up to date with table, returns the number of blocks evaluated
+  std::size_t refresh(table_data const& table){
+    std::vector<block_ptr> seen;   //keeps the blocks the keys of known point to alive
+    std::unordered_map<table_block const*, std::shared_ptr<std::vector<Row>>> known;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if( table.version_ <= version_ ) return 0;
+      seen = seen_;
+      for(std::size_t b = 0; b < seen_.size(); ++b){ known[seen_[b].get()] = rows_[b]; }
+    }
+
+    std::size_t blocks = table.blocks_.size();
+    std::vector<std::shared_ptr<std::vector<Row>>> rows(blocks);
+    std::vector<std::size_t> changed;
+    for(std::size_t b = 0; b < blocks; ++b){
+      auto it = known.find(table.blocks_[b].get());
+      if( it != known.end() ) rows[b] = it->second;
+      else changed.push_back(b);
+    }
+
+    run_morsels(workers_for(changed.size()), changed.size(), [&](unsigned, std::size_t i){
+      std::shared_ptr<std::vector<Row>> block_rows(new std::vector<Row>());
+      compute_(*table.blocks_[changed[i]], *block_rows);
+      rows[changed[i]] = block_rows;
+      return true;
+    });
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if( table.version_ <= version_ ) return 0;
+    seen_ = table.blocks_;
+    rows_.swap(rows);
+    version_ = table.version_;
+    return changed.size();
+  }
+
+  //the rows of the view, in table order
+  template<typename F>
+  void read(F fn) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for(auto& block : rows_){
+      for(auto& row : *block){ fn(row); }
+    }
+  }
+
+  std::size_t size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::size_t n = 0;
+    for(auto& block : rows_){ n += block->size(); }
+    return n;
+  }
+
+private:
+  compute_fn compute_;
+  std::uint64_t version_;
+  std::vector<block_ptr> seen_;
+  std::vector<std::shared_ptr<std::vector<Row>>> rows_;
+  mutable std::mutex mutex_;
+};
+
+#endif
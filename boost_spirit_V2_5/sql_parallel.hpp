@@ -0,0 +1,80 @@
+#ifndef SQL_PARALLEL_HPP
+#define SQL_PARALLEL_HPP
+
+#include "sql_cancel.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+Morsel driven parallelism: every query starts worker_count() workers and the workers pull
+blocks from a shared atomic counter until there is nothing left (or nothing more is needed).
+The workers run under the query_token of the calling thread (see sql_cancel.hpp), they yield to
+the scheduler before every block and stop taking blocks once the token is stopped.
+*/
+
+inline unsigned worker_count(){
+  unsigned n = std::thread::hardware_concurrency();
+  return n ? n : 1;
+}
+
+//runs fn(worker) on n workers, the calling thread is worker 0; throws query_cancelled once the
+//workers are done if the query was stopped meanwhile, else the first exception a worker threw
+template<typename F>
+void run_workers(unsigned n, F fn){
+  query_token const* query = current_query();
+  std::exception_ptr error;
+  std::mutex error_mutex;
+  auto run = [&](unsigned w){
+    try{
+      fn(w);
+    }catch(...){
+      std::lock_guard<std::mutex> lock(error_mutex);
+      if( !error ) error = std::current_exception();
+    }
+  };
+  std::vector<std::thread> threads;
+  for(unsigned w = 1; w < n; ++w){
+    threads.emplace_back([query, &run, w]{
+      query_scope scope(query);
+      run(w);
+    });
+  }
+  run(0u);
+  for(auto& t : threads){ t.join(); }
+  check_query();
+  if( error ) std::rethrow_exception(error);
+}
+
+//hands out the morsels 0..count-1 in order to n workers, fn(worker, morsel) returns false to stop
+//handing out further morsels (the morsels already claimed are still completed); so does a throw
+template<typename F>
+void run_morsels(unsigned n, std::size_t count, F fn){
+  std::atomic<std::size_t> next(0);
+  std::atomic<bool> stop(false);
+  run_workers(n, [&](unsigned worker){
+    while( !stop.load(std::memory_order_relaxed) ){
+      query_yield();
+      if( query_stopped() ) return;
+      std::size_t morsel = next.fetch_add(1);
+      if( morsel >= count ) return;
+      try{
+        if( !fn(worker, morsel) ) stop = true;
+      }catch(...){
+        stop = true;
+        throw;
+      }
+    }
+  });
+}
+
+//n workers, but never more than there are morsels to share
+inline unsigned workers_for(std::size_t count){
+  return static_cast<unsigned>(count < worker_count() ? (count ? count : 1) : worker_count());
+}
+
+#endif
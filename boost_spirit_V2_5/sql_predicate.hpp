@@ -0,0 +1,251 @@
+#ifndef SQL_PREDICATE_HPP
+#define SQL_PREDICATE_HPP
+
+#include "sql_table.hpp"
+
+#include <boost/utility/string_ref.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*
+Compiled row predicates.
+
+A condition is compiled once per statement into a filter specialized for its column kind, its
+operator and the type of its literal: the row loops below are template instances testing a row
+with one plain comparison, there is no switch on the operator nor a visit of the literal's variant
+per row. The one indirect call is per batch: filter() narrows a vector of candidate rows in place
+(branch free, every row is written and the output index moves by the result of the test).
+A conjunction compiles into an and_filter whose children narrow the rows left by the previous one.
+The comparisons of int columns with a literal are not compiled here: they run a batch at a time on
+the compressed columns (int_column::match), the filters only narrow the rows surviving them.
+
+The null handling is chosen per batch as well: a column without a validity bitmap runs the loop
+without the null test. Dictionary encoded string columns test every distinct string of the block
+once, when the dictionary is smaller than the batch, and then only look the codes up. == and !=
+on the other string columns compare the lengths from the offsets first and the bytes only of the
+strings of the right length, with one SIMD compare of the first 16 bytes (32 with AVX2).
+*/
+
+enum compare_op { cmp_eq, cmp_neq, cmp_lt, cmp_le, cmp_gt, cmp_ge, cmp_between };
+
+class row_filter{
+public:
+  virtual ~row_filter(){}
+
+  //keeps the rows of rows[first, end) passing the filter, in order
+  virtual void filter(table_block const& block, std::vector<std::uint32_t>& rows, std::size_t first) const = 0;
+};
+
+using row_filter_ptr = std::shared_ptr<row_filter const>;
+
+namespace predicate_detail{
+
+  template<typename Pass>
+  void keep_if(std::vector<std::uint32_t>& rows, std::size_t first, Pass pass){
+    std::size_t out = first;
+    for(std::size_t i = first; i < rows.size(); ++i){
+      std::uint32_t r = rows[i];
+      rows[out] = r;
+      out += pass(r);
+    }
+    rows.resize(out);
+  }
+
+  //the test of one value against the literal(s)
+  template<compare_op Op>
+  struct string_test{
+    std::string lo_, hi_;
+    bool operator()(boost::string_ref s) const {
+      int c = s.compare(boost::string_ref(lo_));
+      return Op == cmp_lt ? c < 0 : Op == cmp_le ? c <= 0 : Op == cmp_gt ? c > 0 : c >= 0;
+    }
+  };
+
+  template<>
+  struct string_test<cmp_eq>{
+    std::string lo_, hi_;
+    bool operator()(boost::string_ref s) const { return s == boost::string_ref(lo_); }
+  };
+
+  template<>
+  struct string_test<cmp_neq>{
+    std::string lo_, hi_;
+    bool operator()(boost::string_ref s) const { return s != boost::string_ref(lo_); }
+  };
+
+  template<>
+  struct string_test<cmp_between>{
+    std::string lo_, hi_;
+    bool operator()(boost::string_ref s) const { return s.compare(boost::string_ref(lo_)) >= 0 && s.compare(boost::string_ref(hi_)) <= 0; }
+  };
+
+  /*
+  string r == literal on the offsets + heap layout: the lengths, then the first prefix_bytes of the
+  string against the literal padded with zeros in one vector compare (the bytes past the string do
+  not count), memcmp for the rest of longer strings. A vector load never reads past the heap, the
+  strings ending closer than prefix_bytes to its end go to memcmp.
+  */
+  class equal_kernel{
+  public:
+#if defined(__AVX2__)
+    static const std::size_t prefix_bytes = 32;
+#else
+    static const std::size_t prefix_bytes = 16;
+#endif
+
+    explicit equal_kernel(std::string const& literal)
+      : size_(literal.size()), padded_(literal),
+        care_(literal.size() >= 32 ? 0xffffffffu : (std::uint32_t(1) << literal.size()) - 1) {
+      padded_.resize(size_ > prefix_bytes ? size_ : prefix_bytes, '\0');
+    }
+
+    bool operator()(string_column const& s, std::uint32_t r) const {
+      std::uint32_t begin = s.offsets_[r];
+      if( s.offsets_[r + 1] - begin != size_ ) return false;
+      if( begin > s.heap_.size() || size_ > s.heap_.size() - begin ) throw std::runtime_error("corrupt string column");
+      if( size_ == 0 ) return true;
+      char const* p = s.heap_.data() + begin;
+      if( begin + prefix_bytes > s.heap_.size() ) return std::memcmp(p, padded_.data(), size_) == 0;
+      if( !prefix_equal(p) ) return false;
+      return size_ <= prefix_bytes || std::memcmp(p + prefix_bytes, padded_.data() + prefix_bytes, size_ - prefix_bytes) == 0;
+    }
+
+  private:
+    bool prefix_equal(char const* p) const {
+#if defined(__AVX2__)
+      __m256i eq = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<__m256i const*>(p)),
+                                     _mm256_loadu_si256(reinterpret_cast<__m256i const*>(padded_.data())));
+      return (static_cast<std::uint32_t>(_mm256_movemask_epi8(eq)) & care_) == care_;
+#elif defined(__SSE2__)
+      __m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<__m128i const*>(p)),
+                                  _mm_loadu_si128(reinterpret_cast<__m128i const*>(padded_.data())));
+      return (static_cast<std::uint32_t>(_mm_movemask_epi8(eq)) & care_ & 0xffffu) == (care_ & 0xffffu);
+#else
+      return std::memcmp(p, padded_.data(), size_ < prefix_bytes ? size_ : prefix_bytes) == 0;
+#endif
+    }
+
+    std::size_t size_;
+    std::string padded_;
+    std::uint32_t care_;   //bit i: byte i of the prefix belongs to the literal
+  };
+
+  inline bool valid_at(column_chunk const& col, std::uint32_t r){
+    return (col.validity_[r >> 6] >> (r & 63)) & 1;
+  }
+
+  template<compare_op Op>
+  class string_filter : public row_filter{
+  public:
+    string_filter(int column, std::string lo, std::string hi) : column_(column), equal_(lo) {
+      test_.lo_ = std::move(lo);
+      test_.hi_ = std::move(hi);
+    }
+
+    void filter(table_block const& block, std::vector<std::uint32_t>& rows, std::size_t first) const {
+      if( first == rows.size() ) return;
+      column_chunk const& col = block.columns_[column_];
+      string_column const& s = col.strings_;
+      bool nullable = !col.validity_.empty();
+      std::size_t entries = s.offsets_.size() - 1;
+      if( s.dictionary() && entries <= rows.size() - first ){
+        std::vector<char> pass(entries);
+        for(std::size_t e = 0; e < entries; ++e){ pass[e] = test_(s.entry(e)); }
+        std::uint32_t top = 0;
+        for(std::size_t i = first; i < rows.size(); ++i){ top = std::max(top, s.codes_[rows[i]]); }
+        if( top >= entries ) throw std::runtime_error("corrupt string column");
+        if( nullable ) keep_if(rows, first, [&](std::uint32_t r){ return valid_at(col, r) && pass[s.codes_[r]]; });
+        else keep_if(rows, first, [&](std::uint32_t r){ return pass[s.codes_[r]] != 0; });
+        return;
+      }
+      if( Op == cmp_eq || Op == cmp_neq ){
+        if( nullable ) keep_if(rows, first, [&](std::uint32_t r){ return valid_at(col, r) && equal_(s, r) == (Op == cmp_eq); });
+        else keep_if(rows, first, [&](std::uint32_t r){ return equal_(s, r) == (Op == cmp_eq); });
+        return;
+      }
+      if( nullable ) keep_if(rows, first, [&](std::uint32_t r){ return valid_at(col, r) && test_(s.get(r)); });
+      else keep_if(rows, first, [&](std::uint32_t r){ return test_(s.get(r)); });
+    }
+
+  private:
+    int column_;
+    equal_kernel equal_;
+    string_test<Op> test_;
+  };
+
+  template<bool WantNull>
+  class null_filter : public row_filter{
+  public:
+    explicit null_filter(int column) : column_(column) {}
+
+    void filter(table_block const& block, std::vector<std::uint32_t>& rows, std::size_t first) const {
+      column_chunk const& col = block.columns_[column_];
+      if( col.validity_.empty() ){
+        if( WantNull ) rows.resize(first);
+        return;
+      }
+      keep_if(rows, first, [&](std::uint32_t r){ return valid_at(col, r) != WantNull; });
+    }
+
+  private:
+    int column_;
+  };
+
+  class and_filter : public row_filter{
+  public:
+    explicit and_filter(std::vector<row_filter_ptr> children) : children_(std::move(children)) {}
+
+    void filter(table_block const& block, std::vector<std::uint32_t>& rows, std::size_t first) const {
+      for(auto& child : children_){
+        if( first == rows.size() ) return;
+        child->filter(block, rows, first);
+      }
+    }
+
+  private:
+    std::vector<row_filter_ptr> children_;
+  };
+}
+
+//column == null (want_null) or column != null
+inline row_filter_ptr compile_null_test(int column, bool want_null){
+  using namespace predicate_detail;
+  if( want_null ) return std::make_shared<null_filter<true>>(column);
+  return std::make_shared<null_filter<false>>(column);
+}
+
+//a string column compared with lo (BETWEEN lo AND hi)
+inline row_filter_ptr compile_string_compare(int column, compare_op op, std::string const& lo, std::string const& hi = std::string()){
+  using namespace predicate_detail;
+  switch( op ){
+    case cmp_eq: return std::make_shared<string_filter<cmp_eq>>(column, lo, hi);
+    case cmp_neq: return std::make_shared<string_filter<cmp_neq>>(column, lo, hi);
+    case cmp_lt: return std::make_shared<string_filter<cmp_lt>>(column, lo, hi);
+    case cmp_le: return std::make_shared<string_filter<cmp_le>>(column, lo, hi);
+    case cmp_gt: return std::make_shared<string_filter<cmp_gt>>(column, lo, hi);
+    case cmp_ge: return std::make_shared<string_filter<cmp_ge>>(column, lo, hi);
+    default: return std::make_shared<string_filter<cmp_between>>(column, lo, hi);
+  }
+}
+
+//every child; null when there is none, the child itself when there is one
+inline row_filter_ptr compile_and(std::vector<row_filter_ptr> children){
+  if( children.empty() ) return nullptr;
+  if( children.size() == 1 ) return children.front();
+  return std::make_shared<predicate_detail::and_filter>(std::move(children));
+}
+
+#endif
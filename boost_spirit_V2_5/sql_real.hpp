@@ -0,0 +1,355 @@
+#ifndef SQL_REAL_HPP
+#define SQL_REAL_HPP
+
+#include "sql_swar.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+/*
+Decimal literal to double, in the style of fast_float (Eisel-Lemire):
+  1. the literal is split into a sign, a mantissa w of at most 19 digits and a power of ten q,
+     the digits read with SWAR (sql_swar.hpp)
+  2. when w < 2^53 and 10^q is exact as a double the result is w * 10^q or w / 10^-q, one
+     correctly rounded operation (Clinger's fast path)
+  3. otherwise w is multiplied by a 128 bit truncation of 5^q; the top bits of the product are
+     the mantissa and the power of two comes from q, rounded to nearest even. The table of
+     truncated powers is computed on first use
+  4. literals with more than 19 significant digits go to strtod
+
+The syntax is the one of qi::double_: an optional sign, digits with an optional '.' (".5" and "5."
+are fine), an optional exponent, or nan / inf / infinity in any case. A literal without '.' and
+without exponent that fits in an int is integral and reported as such.
+*/
+
+struct real_literal{
+  bool integral_;
+  int int_;
+  double double_;
+};
+
+namespace real_detail{
+
+  const int smallest_power = -342;  //10^-342 rounds to 0, even times the largest mantissa
+  const int largest_power = 308;
+
+  //2^b / 5^n and 5^n as little endian 32 bit words, good enough for the table
+  struct bignum{
+    std::vector<std::uint32_t> words_;
+
+    explicit bignum(std::uint32_t v) : words_(1, v) {}
+
+    void multiply(std::uint32_t m){
+      std::uint64_t carry = 0;
+      for(auto& w : words_){
+        carry += std::uint64_t(w) * m;
+        w = static_cast<std::uint32_t>(carry);
+        carry >>= 32;
+      }
+      if( carry ) words_.push_back(static_cast<std::uint32_t>(carry));
+    }
+
+    void divide(std::uint32_t d){
+      std::uint64_t rest = 0;
+      for(std::size_t i = words_.size(); i-- > 0; ){
+        rest = (rest << 32) | words_[i];
+        words_[i] = static_cast<std::uint32_t>(rest / d);
+        rest %= d;
+      }
+      while( words_.size() > 1 && words_.back() == 0 ){ words_.pop_back(); }
+    }
+
+    unsigned bits() const {
+      return static_cast<unsigned>(32 * (words_.size() - 1)) + (32 - __builtin_clz(words_.back()));
+    }
+
+    //bits [from, from + 64)
+    std::uint64_t bits_at(int from) const {
+      std::uint64_t r = 0;
+      for(int i = 0; i < 64; ++i){
+        int b = from + i;
+        if( b >= 0 && static_cast<std::size_t>(b / 32) < words_.size() && ((words_[b / 32] >> (b % 32)) & 1) ) r |= std::uint64_t(1) << i;
+      }
+      return r;
+    }
+  };
+
+  //5^q for q in [smallest_power, largest_power], scaled so that bit 127 is the top bit and
+  //truncated to 128 bits; the negative powers are 2^b / 5^-q + 1 before the truncation
+  inline std::vector<std::uint64_t> make_powers_of_five(){
+    std::vector<std::uint64_t> table;
+    table.reserve(2 * (largest_power - smallest_power + 1));
+    for(int q = smallest_power; q <= largest_power; ++q){
+      bignum five(1);
+      for(int k = 0; k < (q < 0 ? -q : q); ++k){ five.multiply(5); }
+      bignum value(1);
+      if( q >= 0 ){
+        value = five;
+      }else{
+        unsigned z = five.bits();
+        unsigned b = (q >= -27) ? z + 127 : 2 * z + 128;
+        value.words_.assign(b / 32 + 1, 0);
+        value.words_[b / 32] = std::uint32_t(1) << (b % 32);
+        for(int k = 0; k < -q; ++k){ value.divide(5); }
+        std::uint64_t carry = 1;  //+ 1
+        for(std::size_t i = 0; carry && i < value.words_.size(); ++i){
+          std::uint64_t s = std::uint64_t(value.words_[i]) + carry;
+          value.words_[i] = static_cast<std::uint32_t>(s);
+          carry = s >> 32;
+        }
+        if( carry ) value.words_.push_back(1);
+      }
+      int top = static_cast<int>(value.bits()) - 128;  //the 128 bits below and at the top bit
+      table.push_back(value.bits_at(top + 64));
+      table.push_back(value.bits_at(top));
+    }
+    return table;
+  }
+
+  inline std::uint64_t const* powers_of_five(){
+    static const std::vector<std::uint64_t> table = make_powers_of_five();
+    return table.data();
+  }
+
+  inline void multiply(std::uint64_t a, std::uint64_t b, std::uint64_t& high, std::uint64_t& low){
+    unsigned __int128 r = static_cast<unsigned __int128>(a) * b;
+    high = static_cast<std::uint64_t>(r >> 64);
+    low = static_cast<std::uint64_t>(r);
+  }
+
+  //w * 10^q correctly rounded, w != 0
+  inline double eisel_lemire(std::uint64_t w, int q, bool negative){
+    const double sign = negative ? -1.0 : 1.0;
+    if( q < smallest_power ) return sign * 0.0;
+    if( q > largest_power ) return sign * std::numeric_limits<double>::infinity();
+
+    int lz = __builtin_clzll(w);
+    w <<= lz;
+    std::uint64_t const* five = powers_of_five() + 2 * (q - smallest_power);
+    std::uint64_t high, low;
+    multiply(w, five[0], high, low);
+    //the 55 bits needed are not sure yet: add the product with the low half of the power
+    const std::uint64_t precision_mask = ~std::uint64_t(0) >> 55;
+    if( (high & precision_mask) == precision_mask ){
+      std::uint64_t high2, low2;
+      multiply(w, five[1], high2, low2);
+      low += high2;
+      if( high2 > low ) ++high;
+    }
+
+    int upper = static_cast<int>(high >> 63);
+    int shift = upper + 64 - 52 - 3;
+    std::uint64_t mantissa = high >> shift;
+    //floor(q * log2(10)) + 63, then the biased exponent
+    int power2 = static_cast<int>(((152170 + 65536) * static_cast<std::int64_t>(q)) >> 16) + 63 + upper - lz + 1023;
+
+    if( power2 <= 0 ){  //subnormal
+      if( -power2 + 1 >= 64 ) return sign * 0.0;
+      mantissa >>= -power2 + 1;
+      mantissa += mantissa & 1;
+      mantissa >>= 1;
+      power2 = mantissa < (std::uint64_t(1) << 52) ? 0 : 1;
+    }else{
+      //exactly halfway between two doubles: round to even instead of up
+      if( low <= 1 && q >= -4 && q <= 23 && (mantissa & 3) == 1 && (mantissa << shift) == high ) mantissa &= ~std::uint64_t(1);
+      mantissa += mantissa & 1;
+      mantissa >>= 1;
+      if( mantissa >= (std::uint64_t(2) << 52) ){
+        mantissa = std::uint64_t(1) << 52;
+        ++power2;
+      }
+      mantissa &= ~(std::uint64_t(1) << 52);
+      if( power2 >= 0x7ff ) return sign * std::numeric_limits<double>::infinity();
+    }
+    std::uint64_t bits = mantissa | (std::uint64_t(power2) << 52) | (std::uint64_t(negative) << 63);
+    double d;
+    std::memcpy(&d, &bits, sizeof(d));
+    return d;
+  }
+
+  //the exact powers of ten of a double
+  const double exact_powers[23] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                    1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+  //w * 10^q, w < 2^64
+  inline double to_double(std::uint64_t w, int q, bool negative){
+    if( w == 0 ) return negative ? -0.0 : 0.0;
+    if( w <= (std::uint64_t(1) << 53) ){
+      if( q >= -22 && q <= 22 ){
+        double d = static_cast<double>(w);
+        d = q < 0 ? d / exact_powers[-q] : d * exact_powers[q];
+        return negative ? -d : d;
+      }
+    }
+    return eisel_lemire(w, q, negative);
+  }
+
+  inline bool match_word(char const* p, std::size_t n, char const* word, std::size_t len){
+    if( n < len ) return false;
+    for(std::size_t i = 0; i < len; ++i){
+      if( (p[i] | 0x20) != word[i] ) return false;
+    }
+    return true;
+  }
+}
+
+//the literal at the start of [p, p + n): returns its length, 0 when there is none
+inline std::size_t parse_real(char const* p, std::size_t n, real_literal& out){
+  using namespace real_detail;
+  std::size_t i = 0;
+  bool negative = false;
+  if( n && (p[0] == '-' || p[0] == '+') ){
+    negative = p[0] == '-';
+    ++i;
+  }
+  out.integral_ = false;
+
+  //nan, inf, infinity
+  if( i < n && ((p[i] | 0x20) == 'n' || (p[i] | 0x20) == 'i') ){
+    double sign = negative ? -1.0 : 1.0;
+    if( match_word(p + i, n - i, "nan", 3) ){
+      out.double_ = sign * std::numeric_limits<double>::quiet_NaN();
+      return i + 3;
+    }
+    if( match_word(p + i, n - i, "inf", 3) ){
+      out.double_ = sign * std::numeric_limits<double>::infinity();
+      return match_word(p + i, n - i, "infinity", 8) ? i + 8 : i + 3;
+    }
+    return 0;
+  }
+
+  if( i == n || ((p[i] < '0' || p[i] > '9') && p[i] != '.') ) return 0;
+
+  char const* start = p + i;
+#if defined(__SSE2__)
+  //the usual literals, up to 8 digits before and after the '.', found with one 16 byte compare
+  if( n - i >= 16 ){
+    __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(start));
+    unsigned other = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_sub_epi8(v, _mm_set1_epi8('0' - 128)), _mm_set1_epi8(-119)))) | 0x10000;
+    unsigned a = static_cast<unsigned>(__builtin_ctz(other)), b = 0, end = a;
+    bool dot = a < 16 && start[a] == '.';   //a == 16: 16 digits, start[16] may be past the text
+    if( dot ){
+      b = static_cast<unsigned>(__builtin_ctz(other >> (a + 1)));
+      end = a + 1 + b;
+    }
+    if( a <= 8 && b <= 8 && end < 16 && a + b > 0 ){
+      std::uint64_t w;
+      std::memcpy(&w, start, 8);
+      std::uint64_t whole = a ? swar_leading_digits(w, a) : 0;
+      bool e = (start[end] | 0x20) == 'e';
+      if( !dot && !e ){
+        out.integral_ = true;
+        out.int_ = negative ? -static_cast<int>(whole) : static_cast<int>(whole);
+        out.double_ = negative ? -static_cast<double>(whole) : static_cast<double>(whole);
+        return i + a;
+      }
+      std::uint64_t mantissa = whole;
+      if( b ){
+        std::memcpy(&w, start + a + 1, 8);
+        mantissa = whole * static_cast<std::uint64_t>(exact_powers[b]) + swar_leading_digits(w, b);
+      }
+      int q = -static_cast<int>(b);
+      if( e ){
+        //a short exponent; without digits the e is not part of the literal
+        std::size_t j = i + end + 1;
+        bool exp_negative = j < n && p[j] == '-';
+        if( j < n && (p[j] == '-' || p[j] == '+') ) ++j;
+        int exponent = 0;
+        std::size_t k = j;
+        for(; k < n && k < j + 4 && p[k] >= '0' && p[k] <= '9'; ++k){ exponent = exponent * 10 + (p[k] - '0'); }
+        if( k > j && !(k < n && p[k] >= '0' && p[k] <= '9') ){
+          q += exp_negative ? -exponent : exponent;
+          out.double_ = to_double(mantissa, q, negative);
+          return k;
+        }
+        if( k == j ){
+          //no exponent: an int without a '.', as on the scalar path
+          if( !dot ){
+            out.integral_ = true;
+            out.int_ = negative ? -static_cast<int>(whole) : static_cast<int>(whole);
+            out.double_ = negative ? -static_cast<double>(whole) : static_cast<double>(whole);
+            return i + a;
+          }
+          out.double_ = to_double(mantissa, q, negative);
+          return i + end;
+        }
+        //more exponent digits: the general path
+      }else{
+        out.double_ = to_double(mantissa, q, negative);
+        return i + end;
+      }
+    }
+  }
+#endif
+
+  std::uint64_t value, fraction = 0;
+  bool overflow;
+  std::size_t int_digits = swar_parse_digits(start, n - i, value, overflow);
+  i += int_digits;
+  std::size_t frac_digits = 0;
+  bool dot = i < n && p[i] == '.';
+  if( dot ){
+    bool ignored;  //more than 19 digits go to strtod
+    frac_digits = swar_parse_digits(p + i + 1, n - i - 1, fraction, ignored);
+    if( int_digits == 0 && frac_digits == 0 ) return 0;
+    i += 1 + frac_digits;
+  }else if( int_digits == 0 ){
+    return 0;
+  }
+
+  //the exponent, only when there are digits after the e
+  long exponent = 0;
+  bool has_exponent = false;
+  if( i < n && (p[i] | 0x20) == 'e' ){
+    std::size_t j = i + 1;
+    bool exp_negative = false;
+    if( j < n && (p[j] == '-' || p[j] == '+') ){
+      exp_negative = p[j] == '-';
+      ++j;
+    }
+    std::size_t k = j;
+    for(; k < n && p[k] >= '0' && p[k] <= '9'; ++k){
+      if( exponent < 100000 ) exponent = exponent * 10 + (p[k] - '0');
+    }
+    if( k > j ){
+      has_exponent = true;
+      if( exp_negative ) exponent = -exponent;
+      i = k;
+    }
+  }
+
+  if( !dot && !has_exponent && !overflow && value <= (negative ? 2147483648ull : 2147483647ull) ){
+    out.integral_ = true;
+    out.int_ = negative ? static_cast<int>(-static_cast<std::int64_t>(value)) : static_cast<int>(value);
+    out.double_ = negative ? -static_cast<double>(value) : static_cast<double>(value);  //-0 too
+    return i;
+  }
+
+  //the significant digits: leading zeros do not count
+  char const* digits = start;
+  std::size_t count = int_digits + frac_digits;
+  std::size_t zeros = 0;
+  for(; zeros < count; ++zeros){
+    char c = (zeros < int_digits) ? digits[zeros] : digits[zeros + 1];
+    if( c != '0' ) break;
+  }
+  //w and fraction hold their digits exactly when there are at most 19 of them
+  if( count - zeros <= 19 && frac_digits <= 19 ){
+    static const std::uint64_t powers[20] = { 1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull,
+      100000000ull, 1000000000ull, 10000000000ull, 100000000000ull, 1000000000000ull, 10000000000000ull,
+      100000000000000ull, 1000000000000000ull, 10000000000000000ull, 100000000000000000ull,
+      1000000000000000000ull, 10000000000000000000ull };
+    std::uint64_t w = value * powers[frac_digits] + fraction;
+    out.double_ = to_double(w, static_cast<int>(exponent - static_cast<long>(frac_digits)), negative);
+  }else{
+    std::string text(p, i);
+    out.double_ = std::strtod(text.c_str(), nullptr);
+  }
+  return i;
+}
+
+#endif
@@ -0,0 +1,137 @@
+#ifndef SQL_RESULT_CACHE_HPP
+#define SQL_RESULT_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/*
+Result cache for repeated statements.
+
+Entries are keyed by the canonical text of a statement plus the versions of the tables it reads
+(see table_data::version_), so a write to a table makes every entry over it unreachable at once.
+Those entries are also dropped eagerly: the first entry stored for a newer version of a table, or
+an explicit invalidate(table), removes the entries over its older versions.
+
+Memory is bounded by max_bytes (as estimated by the caller), least recently used entries go first.
+An entry bigger than the whole budget is not stored.
+*/
+
+struct result_cache_stats{
+  std::uint64_t hits_ = 0;
+  std::uint64_t misses_ = 0;
+  std::uint64_t evictions_ = 0;       //dropped for room
+  std::uint64_t invalidations_ = 0;   //dropped because a table changed
+  std::size_t entries_ = 0;
+  std::size_t bytes_ = 0;
+};
+
+//the tables a statement reads, with the version each was read at
+using table_versions = std::vector<std::pair<std::string, std::uint64_t>>;
+
+template<typename Value>
+class result_cache{
+public:
+  explicit result_cache(std::size_t max_bytes) : max_bytes_(max_bytes) {}
+
+  static std::string key(std::string const& statement, table_versions const& tables){
+    std::string k = statement;
+    for(auto& t : tables){ k += "\n" + t.first + "@" + std::to_string(t.second); }
+    return k;
+  }
+
+  std::shared_ptr<Value const> find(std::string const& key){
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if( it == index_.end() ){
+      ++stats_.misses_;
+      return nullptr;
+    }
+    ++stats_.hits_;
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return it->second->value_;
+  }
+
+  void insert(std::string const& key, table_versions const& tables, std::shared_ptr<Value const> value, std::size_t bytes){
+    if( bytes > max_bytes_ ) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for(auto& t : tables){
+      std::uint64_t& latest = latest_[t.first];
+      if( t.second < latest ) return; //read an old version, somebody already cached a newer one
+      if( t.second > latest ){
+        latest = t.second;
+        drop_if([&](entry const& e){ return e.reads(t.first, t.second); });
+      }
+    }
+    if( index_.count(key) ) return;
+
+    lru_.push_front(entry{key, tables, std::move(value), bytes});
+    index_[key] = lru_.begin();
+    stats_.bytes_ += bytes;
+    while( stats_.bytes_ > max_bytes_ ){
+      entry& victim = lru_.back();
+      stats_.bytes_ -= victim.bytes_;
+      index_.erase(victim.key_);
+      lru_.pop_back();
+      ++stats_.evictions_;
+    }
+  }
+
+  //drops every entry reading table
+  void invalidate(std::string const& table){
+    std::lock_guard<std::mutex> lock(mutex_);
+    drop_if([&](entry const& e){ return e.reads(table, ~std::uint64_t(0)); });
+  }
+
+  result_cache_stats stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    result_cache_stats s = stats_;
+    s.entries_ = lru_.size();
+    return s;
+  }
+
+private:
+  struct entry{
+    std::string key_;
+    table_versions tables_;
+    std::shared_ptr<Value const> value_;
+    std::size_t bytes_;
+
+    //reads table at a version older than version
+    bool reads(std::string const& table, std::uint64_t version) const {
+      for(auto& t : tables_){
+        if( t.first == table && t.second < version ) return true;
+      }
+      return false;
+    }
+  };
+
+  template<typename Pred>
+  void drop_if(Pred pred){
+    for(auto it = lru_.begin(); it != lru_.end(); ){
+      if( !pred(*it) ){
+        ++it;
+        continue;
+      }
+      stats_.bytes_ -= it->bytes_;
+      index_.erase(it->key_);
+      it = lru_.erase(it);
+      ++stats_.invalidations_;
+    }
+  }
+
+  std::size_t max_bytes_;
+  std::list<entry> lru_;
+  std::unordered_map<std::string, typename std::list<entry>::iterator> index_;
+  std::unordered_map<std::string, std::uint64_t> latest_;
+  result_cache_stats stats_;
+  mutable std::mutex mutex_;
+};
+
+#endif
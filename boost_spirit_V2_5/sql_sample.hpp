@@ -0,0 +1,87 @@
+#ifndef SQL_SAMPLE_HPP
+#define SQL_SAMPLE_HPP
+
+#include "sql_hash_agg.hpp"
+#include "sql_table.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <unordered_set>
+#include <vector>
+
+/*
+TABLESAMPLE: the sample is a table of its own, the query then runs against it unchanged.
+Every decision comes from the seed, so the same seed gives the same sample.
+
+  p PERCENT   Bernoulli sampling of whole blocks: the sample shares the chosen (immutable) blocks
+              with the table and the other blocks are never read. Tables with fewer than
+              sample_min_blocks blocks would give a too coarse sample, their 1024 row pages are
+              sampled instead and only the chosen pages are copied.
+  n ROWS      n distinct row positions drawn uniformly (Floyd's algorithm), only the blocks
+              holding them are touched and only those rows are copied.
+*/
+
+const std::size_t sample_min_blocks = 32;
+const std::size_t sample_page_rows = 1024;
+
+//deterministic coin for unit (e.g. a block), true with probability fraction
+inline bool sample_coin(unsigned seed, std::uint64_t unit, double fraction){
+  std::uint64_t h = hash_int((std::uint64_t(seed) << 40) ^ unit);
+  return static_cast<double>(h >> 11) * (1.0 / 9007199254740992.0) < fraction;
+}
+
+inline table_data sample_percent(table_data const& table, double percent, unsigned seed){
+  double fraction = percent / 100.0;
+  table_data sample;
+  sample.schema_ = table.schema_;
+
+  if( table.blocks_.size() >= sample_min_blocks ){
+    for(std::size_t b = 0; b < table.blocks_.size(); ++b){
+      if( sample_coin(seed, b, fraction) ) sample.blocks_.push_back(table.blocks_[b]);
+    }
+    return sample;
+  }
+
+  table_builder builder(sample);
+  std::uint64_t page = 0;
+  for(auto& block : table.blocks_){
+    for(std::size_t start = 0; start < block->rows_; start += sample_page_rows, ++page){
+      if( !sample_coin(seed, page, fraction) ) continue;
+      for(std::size_t r = start; r < std::min(block->rows_, start + sample_page_rows); ++r){
+        builder.copy_row(*block, r).end_row();
+      }
+    }
+  }
+  builder.finish();
+  return sample;
+}
+
+inline table_data sample_rows(table_data const& table, std::size_t n, unsigned seed){
+  std::size_t rows = table.rows();
+  if( n >= rows ) return table;
+
+  //Floyd: n distinct values out of [0, rows) with exactly n draws
+  std::mt19937_64 gen(seed);
+  std::unordered_set<std::size_t> chosen;
+  chosen.reserve(2 * n);
+  for(std::size_t j = rows - n; j < rows; ++j){
+    std::size_t t = std::uniform_int_distribution<std::size_t>(0, j)(gen);
+    if( !chosen.insert(t).second ) chosen.insert(j);
+  }
+  std::vector<std::size_t> positions(chosen.begin(), chosen.end());
+  std::sort(positions.begin(), positions.end());
+
+  table_data sample;
+  sample.schema_ = table.schema_;
+  table_builder builder(sample);
+  std::size_t b = 0, first = 0; //first row position of block b
+  for(auto pos : positions){
+    while( pos >= first + table.blocks_[b]->rows_ ){ first += table.blocks_[b++]->rows_; }
+    builder.copy_row(*table.blocks_[b], pos - first).end_row();
+  }
+  builder.finish();
+  return sample;
+}
+
+#endif
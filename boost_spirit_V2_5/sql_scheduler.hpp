@@ -0,0 +1,194 @@
+#ifndef SQL_SCHEDULER_HPP
+#define SQL_SCHEDULER_HPP
+
+#include "sql_cancel.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+/*
+Admission control in front of the executor.
+
+Statements are submitted with a priority class and wait in a FIFO queue per class; at most slots
+of them run at a time and a free slot always goes to the oldest interactive statement first.
+Every admitted statement runs on its own thread under a query_token created at submission, so its
+deadline counts the time spent in the queue.
+
+Batch statements yield cooperatively: between two morsels (see run_morsels) a batch statement that
+sees interactive statements waiting for a full house gives its slot up, goes back to the head of
+the batch queue and its workers block until it is admitted again. A big scan therefore delays a
+point query by one morsel at most, whatever its size.
+
+submit() blocks while max_queued statements of the class are already waiting, so a fast producer
+can not pile up threads.
+*/
+
+enum query_class { class_interactive, class_batch };
+
+//queueing metrics of one class; the wait of a statement is the time from submit() to its first admission
+struct scheduler_stats{
+  std::size_t queued_ = 0;        //waiting right now
+  std::size_t peak_queued_ = 0;
+  std::size_t running_ = 0;       //holding a slot right now
+  std::uint64_t admitted_ = 0;
+  std::uint64_t yields_ = 0;      //slots given up to interactive statements
+  double total_wait_ms_ = 0;
+  double max_wait_ms_ = 0;
+
+  //wait_histogram_[i] counts the waits of less than 2^i microseconds (and not less than 2^(i-1))
+  std::array<std::uint64_t, 40> wait_histogram_{};
+
+  double mean_wait_ms() const { return admitted_ ? total_wait_ms_ / admitted_ : 0; }
+
+  //upper bound of the q-quantile of the waits (the bound of its histogram bucket), in ms
+  double wait_quantile_ms(double q) const {
+    std::uint64_t rank = static_cast<std::uint64_t>(q * admitted_), seen = 0;
+    for(std::size_t i = 0; i < wait_histogram_.size(); ++i){
+      seen += wait_histogram_[i];
+      if( seen > rank ) return std::min(max_wait_ms_, static_cast<double>(std::uint64_t(1) << i) / 1000);
+    }
+    return max_wait_ms_;
+  }
+};
+
+class query_scheduler{
+public:
+  using clock = std::chrono::steady_clock;
+
+  explicit query_scheduler(unsigned slots, std::size_t max_queued = 1024)
+    : slots_(std::max(slots, 1u)), max_queued_(std::max<std::size_t>(max_queued, 1)), running_(0), in_flight_(0),
+      interactive_waiting_(0) {}
+
+  ~query_scheduler(){ drain(); }
+
+  query_scheduler(query_scheduler const&) = delete;
+  query_scheduler& operator=(query_scheduler const&) = delete;
+
+  //runs job(token) on a thread of its own once admitted, timeout as for query_token
+  void submit(query_class cls, std::function<void(query_token&)> job, clock::duration timeout = clock::duration::zero()){
+    std::shared_ptr<ticket> t(new ticket(cls, timeout));
+    ticket* raw = t.get();
+    t->token_.set_yield([this, raw]{ yield(*raw); });
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [&]{ return queues_[cls].size() < max_queued_; });
+    queues_[cls].push_back(t.get());
+    if( cls == class_interactive ) ++interactive_waiting_;
+    stats_[cls].peak_queued_ = std::max(stats_[cls].peak_queued_, queues_[cls].size());
+    ++in_flight_;
+    dispatch();
+    lock.unlock();
+
+    std::thread([this, t, job]{
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        changed_.wait(lock, [&]{ return t->running_; });
+      }
+      {
+        query_scope scope(&t->token_);
+        job(t->token_);
+      }
+      std::lock_guard<std::mutex> lock(mutex_);
+      t->running_ = false;
+      --running_;
+      --running_per_class_[t->class_];
+      --in_flight_;
+      dispatch();
+      changed_.notify_all();
+    }).detach();
+  }
+
+  //waits until every submitted statement has finished
+  void drain(){
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [&]{ return in_flight_ == 0; });
+  }
+
+  scheduler_stats stats(query_class cls) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    scheduler_stats s = stats_[cls];
+    s.queued_ = queues_[cls].size();
+    s.running_ = running_per_class_[cls];
+    return s;
+  }
+
+private:
+  struct ticket{
+    ticket(query_class cls, clock::duration timeout) : class_(cls), token_(timeout), submitted_(clock::now()) {}
+
+    query_class class_;
+    query_token token_;
+    clock::time_point submitted_;
+    bool admitted_ = false;
+    bool running_ = false;
+  };
+
+  //hands the free slots out, interactive first; called with the mutex held
+  void dispatch(){
+    bool woke = false;
+    while( running_ < slots_ ){
+      query_class cls = !queues_[class_interactive].empty() ? class_interactive : class_batch;
+      if( queues_[cls].empty() ) break;
+      ticket* t = queues_[cls].front();
+      queues_[cls].pop_front();
+      if( cls == class_interactive ) --interactive_waiting_;
+      t->running_ = true;
+      ++running_;
+      ++running_per_class_[cls];
+      if( !t->admitted_ ){
+        t->admitted_ = true;
+        record_wait(stats_[cls], clock::now() - t->submitted_);
+      }
+      woke = true;
+    }
+    if( woke ) changed_.notify_all();
+  }
+
+  static void record_wait(scheduler_stats& s, clock::duration wait){
+    double ms = std::chrono::duration<double, std::milli>(wait).count();
+    std::uint64_t us = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(wait).count());
+    std::size_t bucket = 0;
+    while( bucket + 1 < s.wait_histogram_.size() && (std::uint64_t(1) << bucket) <= us ){ ++bucket; }
+    ++s.admitted_;
+    ++s.wait_histogram_[bucket];
+    s.total_wait_ms_ += ms;
+    s.max_wait_ms_ = std::max(s.max_wait_ms_, ms);
+  }
+
+  //between morsels: the lock is only taken when an interactive statement waits
+  void yield(ticket& t){
+    if( t.class_ != class_batch || interactive_waiting_.load(std::memory_order_relaxed) == 0 ) return;
+    std::unique_lock<std::mutex> lock(mutex_);
+    if( t.running_ && running_ >= slots_ && !queues_[class_interactive].empty() ){
+      t.running_ = false;
+      --running_;
+      --running_per_class_[class_batch];
+      ++stats_[class_batch].yields_;
+      queues_[class_batch].push_front(&t);
+      dispatch();
+    }
+    changed_.wait(lock, [&]{ return t.running_; });
+  }
+
+  unsigned slots_;
+  std::size_t max_queued_;
+  unsigned running_;
+  std::size_t in_flight_;
+  std::atomic<std::size_t> interactive_waiting_;
+  std::array<unsigned, 2> running_per_class_{};
+  std::array<std::deque<ticket*>, 2> queues_;
+  std::array<scheduler_stats, 2> stats_;
+  mutable std::mutex mutex_;
+  std::condition_variable changed_;
+};
+
+#endif
@@ -0,0 +1,168 @@
+#ifndef SQL_SHARED_SCAN_HPP
+#define SQL_SHARED_SCAN_HPP
+
+#include "sql_parallel.hpp"
+#include "sql_table.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/*
+Shared (circular) scans: the full scans of a table running at the same time ride one pass over
+its blocks instead of one pass each.
+
+A scan goes round the table in windows of shared_scan_window() blocks. A query attaches to the
+scan of its table wherever the scan currently is, sees every block of the following windows with
+the others (each block is handed to all the riders while it is in cache) and detaches once it has
+seen every block, i.e. after one full cycle. There is no scan thread: whichever rider is free
+drives the next window, the others wait for it.
+
+Every rider runs its block function under its own query_token, a stopped rider is dropped after
+the window and throws query_cancelled on its own thread; the driver itself runs the window under
+no token so that nobody else's scan is cut short. A block function throwing drops its rider the
+same way, the exception is rethrown on the rider's thread.
+
+The riders yield to the scheduler (query_yield, sql_scheduler.hpp) between windows, on their own
+threads and while nobody waits for them: a batch rider waiting for its slot again stays attached,
+whoever drives the next windows sees its blocks for it. Yielding inside a window would keep the
+scan driven by a parked statement, and an interactive statement scanning the same table would
+wait for it forever. A batch scan therefore delays an interactive statement by one window.
+
+The blocks come in ring order, not table order, so only scans whose result does not depend on
+the block order (full filters, aggregates, top-k heaps) go through here.
+*/
+
+inline std::size_t shared_scan_window(){ return 4 * worker_count(); }
+
+class shared_scan{
+public:
+  explicit shared_scan(table_data const& table) : table_(table), position_(0), driving_(false) {}
+
+  //calls fn(worker, block) once for every block, worker < workers_for(blocks of the table)
+  template<typename F>
+  void scan(F fn){
+    std::size_t blocks = table_.blocks_.size();
+    if( blocks == 0 ) return;
+
+    std::shared_ptr<rider> me(new rider(fn, current_query(), blocks));
+    std::unique_lock<std::mutex> lock(mutex_);
+    riders_.push_back(me);
+    while( !me->done_ ){
+      if( driving_ ){
+        changed_.wait(lock);
+      }else{
+        driving_ = true;
+        std::size_t from = position_, window = std::min(blocks, shared_scan_window());
+        std::vector<std::shared_ptr<rider>> riders = riders_;
+        lock.unlock();
+        try{
+          drive(from, window, riders);
+        }catch(...){
+          for(auto& r : riders){ fail(*r, std::current_exception()); }
+        }
+        lock.lock();
+
+        position_ = (from + window) % blocks;
+        for(auto& r : riders){
+          r->remaining_ -= std::min(window, r->remaining_);
+          if( r->remaining_ == 0 || r->failed_ || (r->token_ && r->token_->stopped()) ){
+            r->done_ = true;
+            riders_.erase(std::find(riders_.begin(), riders_.end(), r));
+          }
+        }
+        driving_ = false;
+        changed_.notify_all();
+      }
+      if( me->done_ ) break;
+      lock.unlock();
+      query_yield();
+      lock.lock();
+    }
+    lock.unlock();
+    if( me->error_ ) std::rethrow_exception(me->error_);
+    check_query();
+  }
+
+private:
+  struct rider{
+    rider(std::function<void(unsigned, std::size_t)> fn, query_token const* token, std::size_t blocks)
+      : fn_(std::move(fn)), token_(token), remaining_(blocks), done_(false), failed_(false) {}
+
+    std::function<void(unsigned, std::size_t)> fn_;
+    query_token const* token_;
+    std::size_t remaining_;   //blocks still to see, from the position of the scan
+    bool done_;
+    std::atomic<bool> failed_;   //fn_ threw, error_ is the first exception
+    std::exception_ptr error_;
+  };
+
+  void fail(rider& r, std::exception_ptr error){
+    std::lock_guard<std::mutex> lock(errors_mutex_);
+    if( r.failed_ ) return;
+    r.error_ = error;
+    r.failed_ = true;
+  }
+
+  //runs the window under no token: nobody yields nor stops in the middle of it
+  void drive(std::size_t from, std::size_t window, std::vector<std::shared_ptr<rider>> const& riders){
+    std::size_t blocks = table_.blocks_.size();
+    query_scope none(nullptr);
+    run_morsels(workers_for(window), window, [&](unsigned w, std::size_t i){
+      for(auto& r : riders){
+        if( i >= r->remaining_ || r->failed_ ) continue;
+        query_scope scope(r->token_);
+        if( query_stopped() ) continue;
+        try{
+          r->fn_(w, (from + i) % blocks);
+        }catch(...){
+          fail(*r, std::current_exception());
+        }
+      }
+      return true;
+    });
+  }
+
+  table_data const& table_;
+  std::size_t position_;
+  bool driving_;
+  std::vector<std::shared_ptr<rider>> riders_;
+  std::mutex mutex_;
+  std::mutex errors_mutex_;
+  std::condition_variable changed_;
+};
+
+//the scan of a table lives as long as somebody scans it
+inline std::shared_ptr<shared_scan> shared_scan_of(table_data const& table){
+  static std::mutex mutex;
+  static std::map<table_data const*, std::weak_ptr<shared_scan>> scans;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  for(auto it = scans.begin(); it != scans.end(); ){
+    if( it->second.expired() ) it = scans.erase(it);
+    else ++it;
+  }
+  std::weak_ptr<shared_scan>& slot = scans[&table];
+  std::shared_ptr<shared_scan> scan = slot.lock();
+  if( !scan ){
+    scan = std::make_shared<shared_scan>(table);
+    slot = scan;
+  }
+  return scan;
+}
+
+//run_morsels over every block of the table, through its shared scan; fn(worker, block) returns
+//nothing, a full scan never stops early
+template<typename F>
+void scan_blocks(table_data const& table, F fn){
+  shared_scan_of(table)->scan(fn);
+}
+
+#endif
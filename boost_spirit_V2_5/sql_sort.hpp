@@ -0,0 +1,182 @@
+#ifndef SQL_SORT_HPP
+#define SQL_SORT_HPP
+
+#include "sql_parallel.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+/*
+Sorting building blocks for ORDER BY:
+  bounded_heap            top-k of a stream, one per worker when there is a LIMIT
+  parallel_radix_sort     stable LSD radix sort of (32 bit key, 32 bit payload) pairs
+  parallel_sort           merge sort: workers sort short runs, then the runs are merged pairwise
+*/
+
+//keeps the k smallest items (according to cmp) pushed so far; front() is the largest of them
+template<typename T, typename Compare>
+class bounded_heap{
+public:
+  bounded_heap(std::size_t k, Compare cmp) : k_(k), cmp_(cmp) { items_.reserve(k); }
+
+  void push(T const& x){
+    if( items_.size() < k_ ){
+      items_.push_back(x);
+      std::push_heap(items_.begin(), items_.end(), cmp_);
+    }else if( k_ && cmp_(x, items_.front()) ){
+      std::pop_heap(items_.begin(), items_.end(), cmp_);
+      items_.back() = x;
+      std::push_heap(items_.begin(), items_.end(), cmp_);
+    }
+  }
+
+  //the kept items in ascending order, the heap is left empty
+  std::vector<T> take_sorted(){
+    std::sort_heap(items_.begin(), items_.end(), cmp_);
+    std::vector<T> out;
+    out.swap(items_);
+    return out;
+  }
+
+private:
+  std::size_t k_;
+  Compare cmp_;
+  std::vector<T> items_;
+};
+
+//merges the sorted per worker top-k lists into the global top-k
+template<typename T, typename Compare>
+std::vector<T> merge_top_k(std::vector<std::vector<T>> const& lists, std::size_t k, Compare cmp){
+  std::vector<T> merged, tmp;
+  for(auto& list : lists){
+    tmp.clear();
+    std::merge(merged.begin(), merged.end(), list.begin(), list.end(), std::back_inserter(tmp), cmp);
+    if( tmp.size() > k ) tmp.resize(k);
+    merged.swap(tmp);
+  }
+  return merged;
+}
+
+/*
+Sorts the items on their high 32 bits only, the low 32 bits just ride along. The sort is stable,
+so items built in payload order come out ordered by (key, payload).
+Every 8 bit pass: each worker counts the digits of its slice, one scan over (digit, worker) turns the
+counts into write offsets, each worker scatters its slice. Passes where all items share the digit
+(small key ranges) are skipped.
+*/
+inline void parallel_radix_sort(std::vector<std::uint64_t>& items){
+  using histogram = std::array<std::size_t, 256>;
+
+  std::size_t n = items.size();
+  unsigned workers = workers_for(n / 4096);
+  std::vector<std::uint64_t> tmp(n);
+  std::vector<histogram> counts(workers);
+
+  auto slice = [&](unsigned w, std::size_t& lo, std::size_t& hi){
+    lo = n * w / workers;
+    hi = n * (w + 1) / workers;
+  };
+
+  for(unsigned shift = 32; shift < 64; shift += 8){
+    run_workers(workers, [&](unsigned w){
+      histogram& h = counts[w];
+      h.fill(0);
+      std::size_t lo, hi;
+      slice(w, lo, hi);
+      for(std::size_t i = lo; i < hi; ++i){
+        if( query_stopped_at(i) ) return;
+        ++h[(items[i] >> shift) & 0xff];
+      }
+    });
+
+    bool single_digit = false;
+    std::size_t offset = 0;
+    for(unsigned d = 0; d < 256; ++d){
+      std::size_t total = 0;
+      for(unsigned w = 0; w < workers; ++w){
+        std::size_t c = counts[w][d];
+        counts[w][d] = offset;
+        offset += c;
+        total += c;
+      }
+      if( total == n ) single_digit = true;
+    }
+    if( single_digit ) continue;
+
+    run_workers(workers, [&](unsigned w){
+      histogram& pos = counts[w];
+      std::size_t lo, hi;
+      slice(w, lo, hi);
+      for(std::size_t i = lo; i < hi; ++i){
+        if( query_stopped_at(i) ) return;
+        tmp[pos[(items[i] >> shift) & 0xff]++] = items[i];
+      }
+    });
+    items.swap(tmp);
+  }
+}
+
+//sorted runs of sort_run_items items are what workers claim, small enough for a cancelled query to
+//give its workers back quickly (see sql_cancel.hpp)
+const std::size_t sort_run_items = 8 * 1024;
+
+//std::merge of [first1, last1) and [first2, last2) into out, giving up once the query is stopped
+template<typename In, typename Out, typename Compare>
+void merge_runs(In first1, In last1, In first2, In last2, Out out, Compare cmp){
+  for(std::size_t k = 1; first1 != last1 && first2 != last2; ++k, ++out){
+    if( query_stopped_at(k) ) return;
+    if( cmp(*first2, *first1) ) *out = *first2++;
+    else *out = *first1++;
+  }
+  out = std::copy(first1, last1, out);
+  std::copy(first2, last2, out);
+}
+
+//std::sort for one worker: runs of sort_run_items then merge rounds, so that a stopped query leaves
+//the range unsorted within a run instead of sorting it to the end
+template<typename It, typename Compare>
+void interruptible_sort(It first, It last, Compare cmp){
+  std::size_t n = last - first;
+  for(std::size_t lo = 0; lo < n && !query_stopped(); lo += sort_run_items){ std::sort(first + lo, first + std::min(n, lo + sort_run_items), cmp); }
+  if( n <= sort_run_items ) return;
+
+  std::vector<typename std::iterator_traits<It>::value_type> items(first, last), tmp(n);
+  for(std::size_t width = sort_run_items; width < n && !query_stopped(); width *= 2){
+    for(std::size_t lo = 0; lo < n; lo += 2 * width){
+      std::size_t mid = std::min(lo + width, n), hi = std::min(lo + 2 * width, n);
+      merge_runs(items.begin() + lo, items.begin() + mid, items.begin() + mid, items.begin() + hi, tmp.begin() + lo, cmp);
+    }
+    items.swap(tmp);
+  }
+  std::copy(items.begin(), items.end(), first);
+}
+
+template<typename T, typename Compare>
+void parallel_sort(std::vector<T>& items, Compare cmp){
+  std::size_t n = items.size();
+  std::size_t runs = (n + sort_run_items - 1) / sort_run_items;
+
+  run_morsels(workers_for(runs), runs, [&](unsigned, std::size_t r){
+    std::sort(items.begin() + r * sort_run_items, items.begin() + std::min(n, (r + 1) * sort_run_items), cmp);
+    return true;
+  });
+
+  //merge rounds: runs [i, i+width) and [i+width, i+2*width) become one, half as many each round
+  std::vector<T> tmp(n);
+  for(std::size_t width = sort_run_items; width < n; width *= 2){
+    std::size_t pairs = (n + 2 * width - 1) / (2 * width);
+    run_morsels(workers_for(pairs), pairs, [&](unsigned, std::size_t p){
+      std::size_t lo = p * 2 * width;
+      std::size_t mid = std::min(lo + width, n);
+      std::size_t hi = std::min(lo + 2 * width, n);
+      merge_runs(items.begin() + lo, items.begin() + mid, items.begin() + mid, items.begin() + hi, tmp.begin() + lo, cmp);
+      return true;
+    });
+    items.swap(tmp);
+  }
+}
+
+#endif
@@ -0,0 +1,306 @@
+#ifndef SQL_STATIC_HPP
+#define SQL_STATIC_HPP
+
+#include "sql_predicate.hpp"
+
+#include <boost/fusion/include/adapt_struct.hpp>
+#include <boost/fusion/include/at_c.hpp>
+#include <boost/fusion/include/size.hpp>
+#include <boost/fusion/include/value_at.hpp>
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+/*
+Compile time schemas: tables of structs adapted with BOOST_FUSION_ADAPT_STRUCT, queried with the
+basic_select2 syntax given as a compile time string
+
+  struct user{ int id; int age; std::string country; };
+  BOOST_FUSION_ADAPT_STRUCT(user, (int, id) (int, age) (std::string, country))
+
+  constexpr char adults[] = "SELECT id, country FROM users WHERE age >= 18 AND country != 'ro';";
+  static_query<user, adults>::for_each(rows, [](int id, std::string const& country){ ... });
+
+The query is parsed by the compiler (constexpr functions over the string, one template per clause):
+column names resolve to member indices through the names BOOST_FUSION_ADAPT_STRUCT records, every
+condition becomes a type specialized for its member, operator and literal, and a mistake (unknown
+column, a string compared with an int member, bad syntax) is a static_assert. What is left at run
+time is the loop over the rows: member accesses, comparisons with constants, no parsing, no name
+lookup and no dispatch.
+
+The subset: SELECT * | column, ... FROM table [WHERE condition AND ...]; with the operators of
+basic_select2 (==, !=, <, <=, >, >=, BETWEEN a AND b) against int or 'string' literals, keywords and
+column names case insensitive. The rows are whatever range the query runs over, the table name is
+not checked against anything.
+*/
+
+namespace static_detail{
+
+  constexpr char lower(char c){ return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c; }
+  constexpr bool is_space(char c){ return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+  constexpr bool is_digit(char c){ return c >= '0' && c <= '9'; }
+  constexpr bool is_alnum(char c){ return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || is_digit(c); }
+
+  constexpr std::size_t skip(char const* s, std::size_t i){ return is_space(s[i]) ? skip(s, i + 1) : i; }
+  constexpr std::size_t ident_end(char const* s, std::size_t i){ return is_alnum(s[i]) ? ident_end(s, i + 1) : i; }
+  constexpr std::size_t digits_end(char const* s, std::size_t i){ return is_digit(s[i]) ? digits_end(s, i + 1) : i; }
+  constexpr std::size_t quote_end(char const* s, std::size_t i){ return (s[i] == '\'' || s[i] == 0) ? i : quote_end(s, i + 1); }
+
+  constexpr long long number(char const* s, std::size_t i, std::size_t j, long long acc){
+    return i == j ? acc : number(s, i + 1, j, acc * 10 + (s[i] - '0'));
+  }
+
+  //s[i, j) is the nul terminated name, case insensitive
+  constexpr bool same_name(char const* s, std::size_t i, std::size_t j, char const* name){
+    return i == j ? *name == 0 : (*name != 0 && lower(s[i]) == lower(*name) && same_name(s, i + 1, j, name + 1));
+  }
+
+  //the (lower case) keyword kw at i, as a whole word
+  constexpr bool keyword(char const* s, std::size_t i, char const* kw){
+    return *kw == 0 ? !is_alnum(s[i]) : (lower(s[i]) == *kw && keyword(s, i + 1, kw + 1));
+  }
+
+  //the comparison at i, -1 when there is none
+  constexpr int op_at(char const* s, std::size_t i){
+    return s[i] == '=' && s[i + 1] == '=' ? cmp_eq
+         : s[i] == '!' && s[i + 1] == '=' ? cmp_neq
+         : s[i] == '<' ? (s[i + 1] == '=' ? cmp_le : cmp_lt)
+         : s[i] == '>' ? (s[i + 1] == '=' ? cmp_ge : cmp_gt)
+         : keyword(s, i, "between") ? cmp_between : -1;
+  }
+
+  constexpr std::size_t op_length(int op){
+    return op == cmp_lt || op == cmp_gt ? 1 : op == cmp_between ? 7 : 2;
+  }
+
+  //the index of the member of Row named s[i, j), -1 if there is none
+  template<typename Row, int I = 0, bool End = (I == boost::fusion::result_of::size<Row>::value)>
+  struct member_lookup{
+    static constexpr int find(char const* s, std::size_t i, std::size_t j){
+      return same_name(s, i, j, boost::fusion::extension::struct_member_name<Row, I>::call()) ? I : member_lookup<Row, I + 1>::find(s, i, j);
+    }
+  };
+
+  template<typename Row, int I>
+  struct member_lookup<Row, I, true>{
+    static constexpr int find(char const*, std::size_t, std::size_t){ return -1; }
+  };
+
+  template<typename Row, int I>
+  using member_type = typename std::decay<typename boost::fusion::result_of::value_at_c<Row, I>::type>::type;
+
+  template<int... I> struct member_list{};
+
+  template<int I, typename List> struct push_front;
+  template<int I, int... J> struct push_front<I, member_list<J...>>{ using type = member_list<I, J...>; };
+
+  template<int N, int... I> struct all_members : all_members<N - 1, N - 1, I...> {};
+  template<int... I> struct all_members<0, I...>{ using type = member_list<I...>; };
+
+  //a literal: -123 or 'text' (Q + begin_ + 1, size_ chars)
+  template<char const* Q, std::size_t Pos>
+  struct literal_at{
+    static constexpr std::size_t begin_ = skip(Q, Pos);
+    static constexpr bool string_ = Q[begin_] == '\'';
+    static constexpr bool negative_ = Q[begin_] == '-';
+    static constexpr std::size_t end_ = string_ ? quote_end(Q, begin_ + 1) + 1 : digits_end(Q, begin_ + negative_);
+    static_assert(string_ ? Q[end_ - 1] == '\'' : end_ > begin_ + negative_, "expected a number or a 'string'");
+
+    static constexpr long long value_ = string_ ? 0 : (negative_ ? -1 : 1) * number(Q, begin_ + negative_, end_, 0);
+    static constexpr std::size_t size_ = string_ ? end_ - begin_ - 2 : 0;
+    static char const* text(){ return Q + begin_ + 1; }
+  };
+
+  //the missing upper bound of the operators other than BETWEEN
+  template<std::size_t Pos>
+  struct no_literal{
+    static constexpr std::size_t end_ = Pos;
+    static constexpr bool string_ = false;
+  };
+
+  //three way comparison of a string member with a literal
+  template<typename Lit>
+  int compare_text(std::string const& v){
+    int c = std::memcmp(v.data(), Lit::text(), v.size() < Lit::size_ ? v.size() : Lit::size_);
+    return c ? c : (v.size() < Lit::size_ ? -1 : v.size() > Lit::size_ ? 1 : 0);
+  }
+
+  //the comparisons, per operator, for arithmetic members (against value_) and string members
+  template<int Op, typename Low, typename High>
+  struct compare;
+
+  template<typename Low, typename High>
+  struct compare<cmp_eq, Low, High>{
+    template<typename T> static bool test(T v){ return v == Low::value_; }
+    static bool test(std::string const& v){ return v.size() == Low::size_ && std::memcmp(v.data(), Low::text(), Low::size_) == 0; }
+  };
+
+  template<typename Low, typename High>
+  struct compare<cmp_neq, Low, High>{
+    template<typename T> static bool test(T v){ return v != Low::value_; }
+    static bool test(std::string const& v){ return !compare<cmp_eq, Low, High>::test(v); }
+  };
+
+  template<typename Low, typename High>
+  struct compare<cmp_lt, Low, High>{
+    template<typename T> static bool test(T v){ return v < Low::value_; }
+    static bool test(std::string const& v){ return compare_text<Low>(v) < 0; }
+  };
+
+  template<typename Low, typename High>
+  struct compare<cmp_le, Low, High>{
+    template<typename T> static bool test(T v){ return v <= Low::value_; }
+    static bool test(std::string const& v){ return compare_text<Low>(v) <= 0; }
+  };
+
+  template<typename Low, typename High>
+  struct compare<cmp_gt, Low, High>{
+    template<typename T> static bool test(T v){ return v > Low::value_; }
+    static bool test(std::string const& v){ return compare_text<Low>(v) > 0; }
+  };
+
+  template<typename Low, typename High>
+  struct compare<cmp_ge, Low, High>{
+    template<typename T> static bool test(T v){ return v >= Low::value_; }
+    static bool test(std::string const& v){ return compare_text<Low>(v) >= 0; }
+  };
+
+  template<typename Low, typename High>
+  struct compare<cmp_between, Low, High>{
+    template<typename T> static bool test(T v){ return v >= Low::value_ && v <= High::value_; }
+    static bool test(std::string const& v){ return compare_text<Low>(v) >= 0 && compare_text<High>(v) <= 0; }
+  };
+
+  //column op literal [AND literal]
+  template<typename Row, char const* Q, std::size_t Pos>
+  struct condition_at{
+    static constexpr std::size_t name_ = skip(Q, Pos);
+    static constexpr int column_ = member_lookup<Row>::find(Q, name_, ident_end(Q, name_));
+    static_assert(column_ >= 0, "unknown column in WHERE");
+
+    static constexpr std::size_t op_pos_ = skip(Q, ident_end(Q, name_));
+    static constexpr int op_ = op_at(Q, op_pos_);
+    static_assert(op_ >= 0, "expected ==, !=, <, <=, >, >= or BETWEEN");
+
+    using low = literal_at<Q, op_pos_ + op_length(op_)>;
+    static constexpr std::size_t and_ = skip(Q, low::end_);
+    static_assert(op_ != cmp_between || keyword(Q, and_, "and"), "expected AND in BETWEEN");
+    using high = typename std::conditional<op_ == cmp_between, literal_at<Q, and_ + 3>, no_literal<low::end_>>::type;
+    static constexpr std::size_t end_ = high::end_;
+
+    using member = member_type<Row, column_>;
+    static_assert(low::string_ ? std::is_same<member, std::string>::value : std::is_arithmetic<member>::value,
+                  "the literal does not match the type of the column");
+    static_assert(op_ != cmp_between || low::string_ == high::string_, "the bounds of BETWEEN differ in type");
+
+    static bool test(Row const& row){ return compare<op_, low, high>::test(boost::fusion::at_c<column_>(row)); }
+  };
+
+  template<std::size_t Pos>
+  struct no_conditions{
+    static constexpr std::size_t end_ = Pos;
+    template<typename Row> static bool test(Row const&){ return true; }
+  };
+
+  //condition AND condition ...
+  template<typename Row, char const* Q, std::size_t Pos>
+  struct conditions_at{
+    using first = condition_at<Row, Q, Pos>;
+    static constexpr std::size_t next_ = skip(Q, first::end_);
+    using rest = typename std::conditional<keyword(Q, next_, "and"), conditions_at<Row, Q, next_ + 3>, no_conditions<next_>>::type;
+    static constexpr std::size_t end_ = rest::end_;
+
+    static bool test(Row const& row){ return first::test(row) && rest::test(row); }
+  };
+
+  template<std::size_t Pos>
+  struct no_columns{
+    static constexpr std::size_t end_ = Pos;
+    using members = member_list<>;
+  };
+
+  //column, column ...
+  template<typename Row, char const* Q, std::size_t Pos>
+  struct columns_at{
+    static constexpr std::size_t name_ = skip(Q, Pos);
+    static constexpr int column_ = member_lookup<Row>::find(Q, name_, ident_end(Q, name_));
+    static_assert(column_ >= 0, "unknown column in the select list");
+
+    static constexpr std::size_t next_ = skip(Q, ident_end(Q, name_));
+    using rest = typename std::conditional<Q[next_] == ',', columns_at<Row, Q, next_ + 1>, no_columns<next_>>::type;
+    static constexpr std::size_t end_ = rest::end_;
+    using members = typename push_front<column_, typename rest::members>::type;
+  };
+
+  //*
+  template<typename Row, std::size_t Pos>
+  struct star_columns{
+    static constexpr std::size_t end_ = Pos + 1;
+    using members = typename all_members<boost::fusion::result_of::size<Row>::value>::type;
+  };
+
+  template<typename Row, typename Members> struct projection;
+
+  template<typename Row, int... I>
+  struct projection<Row, member_list<I...>>{
+    using type = std::tuple<member_type<Row, I>...>;
+
+    template<typename F>
+    static void call(F& fn, Row const& row){ fn(boost::fusion::at_c<I>(row)...); }
+
+    static type make(Row const& row){ return type(boost::fusion::at_c<I>(row)...); }
+  };
+}
+
+template<typename Row, char const* Q>
+class static_query{
+  static constexpr std::size_t select_ = static_detail::skip(Q, 0);
+  static_assert(static_detail::keyword(Q, select_, "select"), "expected SELECT");
+
+  static constexpr std::size_t list_ = static_detail::skip(Q, select_ + 6);
+  using columns = typename std::conditional<Q[list_] == '*', static_detail::star_columns<Row, list_>,
+                                            static_detail::columns_at<Row, Q, list_>>::type;
+
+  static constexpr std::size_t from_ = static_detail::skip(Q, columns::end_);
+  static_assert(static_detail::keyword(Q, from_, "from"), "expected FROM");
+  static constexpr std::size_t table_ = static_detail::skip(Q, from_ + 4);
+  static_assert(static_detail::ident_end(Q, table_) > table_, "expected a table name");
+
+  static constexpr std::size_t where_ = static_detail::skip(Q, static_detail::ident_end(Q, table_));
+  using conditions = typename std::conditional<static_detail::keyword(Q, where_, "where"), static_detail::conditions_at<Row, Q, where_ + 5>,
+                                               static_detail::no_conditions<where_>>::type;
+
+  static constexpr std::size_t end_ = static_detail::skip(Q, conditions::end_);
+  static_assert(Q[end_] == ';', "expected ; after the query (no GROUP BY, ORDER BY or LIMIT here)");
+  static_assert(Q[static_detail::skip(Q, end_ + 1)] == 0, "unexpected text after ;");
+
+  using project = static_detail::projection<Row, typename columns::members>;
+
+public:
+  //the selected members, in select list order
+  using result_row = typename project::type;
+
+  static bool matches(Row const& row){ return conditions::test(row); }
+
+  //fn(selected members...) for every matching row
+  template<typename Range, typename F>
+  static void for_each(Range const& rows, F fn){
+    for(auto const& row : rows){
+      if( conditions::test(row) ) project::call(fn, row);
+    }
+  }
+
+  static std::vector<result_row> run(std::vector<Row> const& rows){
+    std::vector<result_row> out;
+    for(auto const& row : rows){
+      if( conditions::test(row) ) out.push_back(project::make(row));
+    }
+    return out;
+  }
+};
+
+#endif
@@ -0,0 +1,198 @@
+#ifndef SQL_STORE_HPP
+#define SQL_STORE_HPP
+
+#include "sql_epoch.hpp"
+#include "sql_table.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+
+/*
+Writable tables: an append optimized store over the immutable blocks of sql_table.hpp.
+
+A table_store publishes its table as a snapshot, a table_data whose blocks are shared with the
+previous snapshots. A reader takes the current snapshot and keeps it for the whole query: snapshot
+isolation per table, every block it scans belongs to one version. Taking it is lock free (see
+published in sql_epoch.hpp), so a reader never waits for a writer and a writer never waits for a
+reader; writers wait for each other only, build their changes on a copy of the block list and
+publish it with one pointer swap when they are done. A replaced snapshot lives on until the last
+query holding it lets go.
+  insert  the inserting thread builds the new rows into blocks of its own (its write buffer), the
+          write only appends those blocks to the block list
+  update  the blocks holding changed rows are rebuilt with the new values from a snapshot, outside
+          the write lock; the write only swaps them in, and updates the blocks written since
+Every publish gets a new table version (see table_data::version_).
+
+Inserts leave small blocks at the end of the table. The background merger of the catalog merges
+runs of merge_min_blocks small blocks (or of a full block worth of rows) into full blocks, so the
+scans keep working on big blocks; readers of older snapshots keep the small ones alive.
+*/
+
+const std::size_t merge_min_blocks = 8;
+
+class table_store{
+public:
+  explicit table_store(table_data table) : current_(std::make_shared<table_data const>(std::move(table))) {}
+
+  std::shared_ptr<table_data const> snapshot() const { return current_.load(); }
+
+  //change(table) edits a copy of the current table, which is published afterwards
+  template<typename F>
+  void write(F change){
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    table_data next = *snapshot();
+    change(next);
+    next.version_ = next_table_version();
+    current_.store(std::make_shared<table_data const>(std::move(next)));
+  }
+
+  //merges the runs of small blocks, returns false when there was nothing to merge
+  bool compact(){
+    std::shared_ptr<table_data const> current = snapshot();
+    if( !has_run(*current) ) return false;
+
+    write([&](table_data& table){
+      std::vector<block_ptr> blocks;
+      for(std::size_t lo = 0, hi; lo < table.blocks_.size(); lo = hi){
+        hi = run_end(table, lo);
+        if( !mergeable(table, lo, hi) ){
+          hi = std::max(hi, lo + 1);
+          blocks.insert(blocks.end(), table.blocks_.begin() + lo, table.blocks_.begin() + hi);
+          continue;
+        }
+        table_data merged;
+        merged.schema_ = table.schema_;
+        {
+          table_builder builder(merged);
+          for(std::size_t b = lo; b < hi; ++b){
+            table_block const& block = *table.blocks_[b];
+            for(std::size_t r = 0; r < block.rows_; ++r){ builder.copy_row(block, r).end_row(); }
+          }
+        }
+        blocks.insert(blocks.end(), merged.blocks_.begin(), merged.blocks_.end());
+      }
+      table.blocks_.swap(blocks);
+    });
+    return true;
+  }
+
+private:
+  static bool small(table_block const& block){ return block.rows_ < default_block_rows; }
+
+  //the end of the run of small blocks starting at lo (lo itself when block lo is full)
+  static std::size_t run_end(table_data const& table, std::size_t lo){
+    std::size_t hi = lo;
+    while( hi < table.blocks_.size() && small(*table.blocks_[hi]) ){ ++hi; }
+    return hi;
+  }
+
+  static bool mergeable(table_data const& table, std::size_t lo, std::size_t hi){
+    if( hi - lo < 2 ) return false;
+    std::size_t rows = 0;
+    for(std::size_t b = lo; b < hi; ++b){ rows += table.blocks_[b]->rows_; }
+    return hi - lo >= merge_min_blocks || rows >= default_block_rows;
+  }
+
+  static bool has_run(table_data const& table){
+    for(std::size_t lo = 0, hi; lo < table.blocks_.size(); lo = std::max(hi, lo + 1)){
+      hi = run_end(table, lo);
+      if( mergeable(table, lo, hi) ) return true;
+    }
+    return false;
+  }
+
+  published<std::shared_ptr<table_data const>> current_;
+  std::mutex write_mutex_;
+};
+
+//the tables by (lower case) name, with the background merger of their small blocks; the lookups
+//are lock free too, adding a table publishes a new map
+class table_catalog{
+  using store_map = std::map<std::string, std::shared_ptr<table_store>>;
+
+public:
+  table_catalog() : stores_(std::make_shared<store_map const>()), written_(false), stop_(false), merger_([this]{ merge_loop(); }) {}
+
+  ~table_catalog(){
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    merger_.join();
+  }
+
+  table_catalog(table_catalog const&) = delete;
+  table_catalog& operator=(table_catalog const&) = delete;
+
+  void add(std::string const& name, table_data table){
+    std::lock_guard<std::mutex> lock(mutex_);
+    store_map stores = *stores_.load();
+    stores[name] = std::make_shared<table_store>(std::move(table));
+    stores_.store(std::make_shared<store_map const>(std::move(stores)));
+  }
+
+  //null when there is no such table
+  std::shared_ptr<table_store> find(std::string const& name) const {
+    std::shared_ptr<store_map const> stores = stores_.load();
+    auto it = stores->find(name);
+    return it == stores->end() ? nullptr : it->second;
+  }
+
+  //the current snapshot of every table
+  std::map<std::string, std::shared_ptr<table_data const>> snapshot() const {
+    std::map<std::string, std::shared_ptr<table_data const>> tables;
+    std::shared_ptr<store_map const> stores = stores_.load();
+    for(auto& s : *stores){ tables[s.first] = s.second->snapshot(); }
+    return tables;
+  }
+
+  //tells the merger that there may be small blocks to merge
+  void written(){
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      written_ = true;
+    }
+    wake_.notify_all();
+  }
+
+private:
+  //merges after writes, at most every merge_interval, so a burst of inserts is merged in one go
+  void merge_loop(){
+    const std::chrono::milliseconds merge_interval(100);
+    std::unique_lock<std::mutex> lock(mutex_);
+    while( !stop_ ){
+      wake_.wait(lock, [&]{ return stop_ || written_; });
+      if( stop_ ) break;
+      wake_.wait_for(lock, merge_interval, [&]{ return stop_; });
+      written_ = false;
+      lock.unlock();
+      std::shared_ptr<store_map const> stores = stores_.load();
+      for(auto& s : *stores){
+        //a corrupt block of a mapped table (see sql_colfile.hpp) leaves its table as it is
+        try{
+          s.second->compact();
+        }catch(std::exception const&){
+        }
+      }
+      lock.lock();
+    }
+  }
+
+  published<std::shared_ptr<store_map const>> stores_;
+  bool written_;
+  bool stop_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::thread merger_;
+};
+
+#endif
@@ -0,0 +1,119 @@
+#ifndef SQL_SWAR_HPP
+#define SQL_SWAR_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*
+SWAR (SIMD within a register) digit parsing: 8 ascii characters are loaded into one 64 bit word,
+the run of leading digits is found with a few adds and masks, and the digits are combined into
+their value with three multiplications instead of a multiply-add per digit.
+Assumes a little endian machine, like the rest of the storage.
+*/
+
+//the value of 8 digits, the first one in the lowest byte
+inline std::uint32_t swar_eight_digits(std::uint64_t v){
+  v = ((v & 0x0f0f0f0f0f0f0f0full) * 2561) >> 8;
+  v = ((v & 0x00ff00ff00ff00ffull) * 6553601) >> 16;
+  return static_cast<std::uint32_t>(((v & 0x0000ffff0000ffffull) * 42949672960001ull) >> 32);
+}
+
+//number of leading '0'..'9' bytes of the word, 8 if all of them are digits
+inline unsigned swar_digit_count(std::uint64_t v){
+  //a byte of bad is non zero when the byte is not a digit; a carry of the + 6 only ever leaves a
+  //byte that is already not a digit, so the first non digit is always found
+  std::uint64_t bad = ((v & 0xf0f0f0f0f0f0f0f0ull) ^ 0x3030303030303030ull)
+                    | (((v + 0x0606060606060606ull) & 0xf0f0f0f0f0f0f0f0ull) ^ 0x3030303030303030ull);
+  std::uint64_t nonzero = ((((bad & 0x7f7f7f7f7f7f7f7full) + 0x7f7f7f7f7f7f7f7full) | bad) & 0x8080808080808080ull);
+  return nonzero ? static_cast<unsigned>(__builtin_ctzll(nonzero)) / 8 : 8;
+}
+
+//the value of the first len (1..8) digits of the word
+inline std::uint32_t swar_leading_digits(std::uint64_t v, unsigned len){
+  return swar_eight_digits((v - 0x3030303030303030ull) << (8 * (8 - len)));
+}
+
+//up to 8 bytes of [p, p + n), the missing ones zero (not a digit)
+inline std::uint64_t swar_load(char const* p, std::size_t n){
+  std::uint64_t v = 0;
+  if( n >= 8 ) std::memcpy(&v, p, 8);  //a fixed size copy is one load
+  else std::memcpy(&v, p, n);
+  return v;
+}
+
+/*
+The digits at the start of [p, p + n): returns how many there are and their value, 8 digits at a
+time for the first 16, one at a time past that; overflow is set when the value does not fit in
+64 bits (leading zeros never overflow).
+*/
+inline std::size_t swar_parse_digits(char const* p, std::size_t n, std::uint64_t& value, bool& overflow){
+  static const std::uint64_t powers[9] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000 };
+  overflow = false;
+#if defined(__SSE2__)
+  //16 readable bytes: one compare finds the run of digits of both words
+  if( n >= 16 ){
+    __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p));
+    __m128i shifted = _mm_sub_epi8(v, _mm_set1_epi8('0' - 128));  //'0'..'9' to -128..-119
+    unsigned other = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpgt_epi8(shifted, _mm_set1_epi8(-119))));
+    unsigned run = other ? static_cast<unsigned>(__builtin_ctz(other)) : 16;
+    std::uint64_t w;
+    std::memcpy(&w, p, 8);
+    if( run == 0 ){
+      value = 0;
+      return 0;
+    }
+    if( run <= 8 ){
+      value = swar_leading_digits(w, run);
+      return run;
+    }
+    std::uint64_t w2;
+    std::memcpy(&w2, p + 8, 8);
+    value = std::uint64_t(swar_eight_digits(w - 0x3030303030303030ull)) * powers[run - 8] + swar_leading_digits(w2, run - 8);
+    if( run < 16 ) return run;
+  }else
+#endif
+  {
+    std::uint64_t w = swar_load(p, n);
+    unsigned len = swar_digit_count(w);
+    if( len > n ) len = static_cast<unsigned>(n);
+    if( len == 0 ){
+      value = 0;
+      return 0;
+    }
+    value = swar_leading_digits(w, len);
+    if( len < 8 ) return len;
+
+    w = swar_load(p + 8, n - 8);
+    len = std::min<unsigned>(swar_digit_count(w), static_cast<unsigned>(n - 8));
+    if( len == 0 ) return 8;
+    value = value * powers[len] + swar_leading_digits(w, len);
+    if( len < 8 ) return 8 + len;
+  }
+
+  std::size_t i = 16;
+  for(; i < n && p[i] >= '0' && p[i] <= '9'; ++i){
+    std::uint64_t d = static_cast<std::uint64_t>(p[i] - '0');
+    if( value > (~std::uint64_t(0) - d) / 10 ) overflow = true;
+    value = value * 10 + d;
+  }
+  return i;
+}
+
+//[p, p + n) is an optional sign and digits, within the range of int
+inline bool swar_parse_int(char const* p, std::size_t n, int& out){
+  bool negative = n && *p == '-';
+  if( n && (*p == '-' || *p == '+') ){ ++p; --n; }
+  std::uint64_t value;
+  bool overflow;
+  if( n == 0 || swar_parse_digits(p, n, value, overflow) != n || overflow ) return false;
+  if( value > (negative ? 2147483648ull : 2147483647ull) ) return false;
+  out = negative ? static_cast<int>(-static_cast<std::int64_t>(value)) : static_cast<int>(value);
+  return true;
+}
+
+#endif
@@ -0,0 +1,263 @@
+#ifndef SQL_TABLE_HPP
+#define SQL_TABLE_HPP
+
+#include "sql_column_array.hpp"
+#include "sql_compress.hpp"
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/utility/string_ref.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/*
+In-memory columnar tables.
+
+A table is a list of immutable blocks (the morsels the executor hands out to its workers),
+inside a block every column is stored as one contiguous array:
+  int columns     -> int array, compressed when the block is sealed (see sql_compress.hpp)
+  string columns  -> offsets into a contiguous byte heap, or codes into a per block dictionary
+plus an optional validity bitmap when the column holds nulls.
+
+The arrays are either owned (tables built in memory) or borrowed from memory that the block keeps
+alive through backing_ (tables mapped from a file, see sql_colfile.hpp).
+*/
+
+enum column_kind { col_int, col_string };
+
+/*
+Variable length strings: offsets_[i]..offsets_[i+1] is the i-th string inside heap_.
+Dictionary encoded columns (codes_ not empty) keep the distinct strings of the block in
+offsets_/heap_ and row i holds the string number codes_[i].
+The arrays of a mapped table file are not checked when the file is opened (that would read all of
+them): entry() checks the offsets and the code it reads and throws on a corrupt column.
+*/
+struct string_column{
+  column_array<std::uint32_t> offsets_;
+  column_array<char> heap_;
+  column_array<std::uint32_t> codes_;
+
+  string_column(){ offsets_.push_back(0); }
+
+  bool dictionary() const { return !codes_.empty(); }
+
+  std::size_t size() const { return dictionary() ? codes_.size() : offsets_.size() - 1; }
+
+  boost::string_ref entry(std::size_t e) const {
+    if( e + 1 >= offsets_.size() || offsets_[e] > offsets_[e + 1] || offsets_[e + 1] > heap_.size() )
+      throw std::runtime_error("corrupt string column");
+    return boost::string_ref(heap_.data() + offsets_[e], offsets_[e + 1] - offsets_[e]);
+  }
+
+  boost::string_ref get(std::size_t i) const { return entry(dictionary() ? codes_[i] : i); }
+
+  void push_back(boost::string_ref s){
+    heap_.append(s.data(), s.size());
+    offsets_.push_back(static_cast<std::uint32_t>(heap_.size()));
+  }
+};
+
+//one column of one block, only the array matching kind_ is used
+struct column_chunk{
+  column_kind kind_;
+  int_column ints_;
+  string_column strings_;
+
+  //bit i set = row i is not null; empty when the column has no nulls
+  column_array<std::uint64_t> validity_;
+
+  //block statistics, filled in when the block is sealed; min_/max_ of int columns skip the nulls,
+  //sorted_ is set for int columns without nulls whose values never decrease (see int_column::bound)
+  int min_ = 0;
+  int max_ = 0;
+  std::size_t null_count_ = 0;
+  bool sorted_ = false;
+
+  bool null_at(std::size_t row) const {
+    return !validity_.empty() && !((validity_[row >> 6] >> (row & 63)) & 1);
+  }
+
+  std::size_t bytes() const {
+    std::size_t n = validity_.size() * sizeof(std::uint64_t);
+    if( kind_ == col_int ) return n + ints_.bytes();
+    return n + strings_.offsets_.size() * sizeof(std::uint32_t) + strings_.heap_.size() + strings_.codes_.size() * sizeof(std::uint32_t);
+  }
+};
+
+struct table_block{
+  std::size_t rows_ = 0;
+  std::vector<column_chunk> columns_;
+  std::shared_ptr<void const> backing_; //keeps borrowed arrays alive
+};
+
+using block_ptr = std::shared_ptr<table_block const>;
+
+struct table_schema{
+  std::vector<std::string> names_;
+  std::vector<column_kind> kinds_;
+
+  //column names are case insensitive, like the keywords; -1 if there is no such column
+  int find(std::string const& name) const {
+    for(std::size_t c = 0; c < names_.size(); ++c)
+      if( boost::iequals(names_[c], name) ) return static_cast<int>(c);
+    return -1;
+  }
+
+  int at(std::string const& name) const {
+    int c = find(name);
+    if( c < 0 ) throw std::runtime_error("unknown column: " + name);
+    return c;
+  }
+};
+
+//table versions are unique over all tables, so a replaced table never shows a version seen before
+inline std::uint64_t next_table_version(){
+  static std::atomic<std::uint64_t> version(0);
+  return ++version;
+}
+
+struct table_data{
+  table_schema schema_;
+  std::vector<block_ptr> blocks_;
+
+  //changes with every write to the table (a new block), see result caching in sql_result_cache.hpp
+  std::uint64_t version_ = next_table_version();
+
+  std::size_t rows() const {
+    std::size_t n = 0;
+    for(auto& b : blocks_){ n += b->rows_; }
+    return n;
+  }
+
+  //bytes of column data, over all blocks
+  std::size_t bytes() const {
+    std::size_t n = 0;
+    for(auto& b : blocks_){
+      for(auto& col : b->columns_){ n += col.bytes(); }
+    }
+    return n;
+  }
+};
+
+//64K rows per block: big enough to amortize the hand-out, small enough to balance the workers
+const std::size_t default_block_rows = 64 * 1024;
+
+//row at a time builder, seals a new block every block_rows rows
+class table_builder{
+public:
+  explicit table_builder(table_data& table, std::size_t block_rows = default_block_rows)
+    : table_(table), block_rows_(block_rows) {}
+
+  ~table_builder(){ finish(); }
+
+  table_builder& put(std::size_t column, int v){
+    column_chunk& chunk = open().columns_[column];
+    valid(chunk, chunk.ints_.size(), true);
+    chunk.ints_.push_back(v);
+    return *this;
+  }
+
+  table_builder& put(std::size_t column, boost::string_ref s){
+    column_chunk& chunk = open().columns_[column];
+    valid(chunk, chunk.strings_.size(), true);
+    chunk.strings_.push_back(s);
+    return *this;
+  }
+
+  table_builder& put_null(std::size_t column){
+    column_chunk& chunk = open().columns_[column];
+    if( chunk.kind_ == col_int ){
+      valid(chunk, chunk.ints_.size(), false);
+      chunk.ints_.push_back(0);
+    }else{
+      valid(chunk, chunk.strings_.size(), false);
+      chunk.strings_.push_back(boost::string_ref());
+    }
+    return *this;
+  }
+
+  //copies one cell of a row of another block with the same schema
+  table_builder& copy_cell(std::size_t column, table_block const& from, std::size_t row){
+    column_chunk const& col = from.columns_[column];
+    if( col.null_at(row) ) put_null(column);
+    else if( col.kind_ == col_int ) put(column, col.ints_[row]);
+    else put(column, col.strings_.get(row));
+    return *this;
+  }
+
+  //copies every column of a row of another block with the same schema
+  table_builder& copy_row(table_block const& from, std::size_t row){
+    for(std::size_t c = 0; c < from.columns_.size(); ++c){ copy_cell(c, from, row); }
+    return *this;
+  }
+
+  void end_row(){
+    if( ++open().rows_ == block_rows_ ) seal();
+  }
+
+  void finish(){
+    if( block_ && block_->rows_ ) seal();
+  }
+
+private:
+  table_block& open(){
+    if( !block_ ){
+      block_.reset(new table_block());
+      for(auto kind : table_.schema_.kinds_){
+        column_chunk chunk;
+        chunk.kind_ = kind;
+        if( kind == col_int ) chunk.ints_.reserve(block_rows_);
+        else chunk.strings_.offsets_.reserve(block_rows_ + 1);
+        block_->columns_.push_back(std::move(chunk));
+      }
+    }
+    return *block_;
+  }
+
+  //the bitmap only comes to life with the first null of the block
+  static void valid(column_chunk& chunk, std::size_t row, bool is_valid){
+    if( is_valid && chunk.validity_.empty() ) return;
+    if( chunk.validity_.empty() ) chunk.validity_.resize((row + 64) / 64, ~std::uint64_t(0));
+    if( chunk.validity_.size() <= row / 64 ) chunk.validity_.resize(row / 64 + 1, ~std::uint64_t(0));
+    std::uint64_t bit = std::uint64_t(1) << (row & 63);
+    std::uint64_t& word = chunk.validity_.mutable_at(row / 64);
+    word = is_valid ? (word | bit) : (word & ~bit);
+  }
+
+  void seal(){
+    for(auto& chunk : block_->columns_){
+      std::size_t rows = block_->rows_;
+      if( !chunk.validity_.empty() ) chunk.validity_.resize((rows + 63) / 64, ~std::uint64_t(0));
+      chunk.null_count_ = 0;
+      for(std::size_t r = 0; r < rows && !chunk.validity_.empty(); ++r){ chunk.null_count_ += chunk.null_at(r); }
+      if( chunk.kind_ != col_int || chunk.null_count_ == rows ) continue;
+
+      int lo = std::numeric_limits<int>::max(), hi = std::numeric_limits<int>::min();
+      bool sorted = chunk.null_count_ == 0;
+      for(std::size_t r = 0; r < rows; ++r){
+        if( chunk.null_at(r) ) continue;
+        lo = std::min(lo, chunk.ints_[r]);
+        hi = std::max(hi, chunk.ints_[r]);
+        sorted = sorted && (r == 0 || chunk.ints_[r - 1] <= chunk.ints_[r]);
+      }
+      chunk.min_ = lo;
+      chunk.max_ = hi;
+      chunk.sorted_ = sorted;
+      chunk.ints_.compress(chunk.null_count_ ? chunk.validity_.data() : nullptr);
+    }
+    table_.blocks_.push_back(block_ptr(block_.release()));
+    table_.version_ = next_table_version();
+  }
+
+  table_data& table_;
+  std::size_t block_rows_;
+  std::unique_ptr<table_block> block_;
+};
+
+#endif
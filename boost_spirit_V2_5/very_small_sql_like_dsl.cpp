@@ -46,6 +46,9 @@ where not status == "ok" print ident, errorMessage
 #include <boost/optional.hpp>
 #include <boost/variant.hpp>
 
+#include "qi_fast_real.hpp"
+#include "qi_skipper.hpp"
+
 #include <iostream>
 #include <string>
 #include <vector>
@@ -109,8 +112,8 @@ BOOST_FUSION_ADAPT_STRUCT( statement, (std::vector<filter>, filters_) (command,
 
 //...
 
-template<typename Iterator>
-struct dsl_grammar : qi::grammar<Iterator, statement(), ascii::space_type>{
+template<typename Iterator, typename Skipper = fast_space_type>
+struct dsl_grammar : qi::grammar<Iterator, statement(), Skipper>{
   dsl_grammar() : dsl_grammar::base_type(expression_){
     using namespace qi;
 
@@ -122,7 +125,7 @@ struct dsl_grammar : qi::grammar<Iterator, statement(), ascii::space_type>{
     /* a bit of synth attrs magic to generate a regex instead of string, in this way we avoid keeping an op per condition */
     regex_ = strlit_ [ _val = phx::construct<regex>(_1) ];
 
-    value_ = double_ | int_ | strlit_;
+    value_ = number_ | strlit_;  //int or double in one pass
 
     condition_ = (no_case["not"] >> attr(true) | attr(false)) >> property_ >> (no_case["like"] >> regex_ | '=' >> value_ );
 
@@ -145,19 +148,19 @@ struct dsl_grammar : qi::grammar<Iterator, statement(), ascii::space_type>{
   //
   qi::rule<Iterator, property() > property_;
 
-  qi::rule<Iterator, value() , ascii::space_type> regex_;
-  qi::rule<Iterator, value() , ascii::space_type> value_;
+  qi::rule<Iterator, value() , Skipper> regex_;
+  qi::rule<Iterator, value() , Skipper> value_;
 
-  qi::rule<Iterator, condition() , ascii::space_type> condition_;
+  qi::rule<Iterator, condition() , Skipper> condition_;
   
-  qi::rule<Iterator, set_command() , ascii::space_type> set_;
-  qi::rule<Iterator, print_command() , ascii::space_type> print_;
-  qi::rule<Iterator, command() , ascii::space_type> command_;
+  qi::rule<Iterator, set_command() , Skipper> set_;
+  qi::rule<Iterator, print_command() , Skipper> print_;
+  qi::rule<Iterator, command() , Skipper> command_;
 
-  qi::rule<Iterator, std::vector<filter>() , ascii::space_type> filters_;
+  qi::rule<Iterator, std::vector<filter>() , Skipper> filters_;
 
   //statement
-  qi::rule<Iterator, statement(), ascii::space_type> expression_;
+  qi::rule<Iterator, statement(), Skipper> expression_;
 };
 
 //g++ file.cpp -std=c++11
@@ -171,7 +174,7 @@ int main( /* ... */ ){
     auto iter = line.begin();
     auto end = line.end();
 
-    ascii::space_type ws;
+    fast_space_type ws;
     dsl_grammar<std::string::iterator> gram;
 
     statement s;